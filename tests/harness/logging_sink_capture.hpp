@@ -0,0 +1,96 @@
+/******************************************************************************
+ *  File Name:
+ *    logging_sink_capture.hpp
+ *
+ *  Description:
+ *    Test double for a logging sink that records everything written to it
+ *
+ *  2024 | Brandon Braun | brandonbraun653@protonmail.com
+ *****************************************************************************/
+
+#pragma once
+#ifndef MBEDUTILS_TEST_LOGGING_SINK_CAPTURE_HPP
+#define MBEDUTILS_TEST_LOGGING_SINK_CAPTURE_HPP
+
+/*-----------------------------------------------------------------------------
+Includes
+-----------------------------------------------------------------------------*/
+#include <cstddef>
+#include <etl/string.h>
+#include <etl/vector.h>
+#include <mbedutils/logging.hpp>
+
+namespace TestHarness
+{
+  /*---------------------------------------------------------------------------
+  Classes
+  ---------------------------------------------------------------------------*/
+
+  /**
+   * @brief Sink that stores each accepted message in RAM for later inspection.
+   *
+   * Applies the same enabled/logLevel filtering a real sink would, so it can
+   * stand in for any downstream sink when testing logging pipeline stages.
+   */
+  class CaptureSink : public mb::logging::SinkInterface
+  {
+  public:
+    struct Entry
+    {
+      mb::logging::Level level;
+      etl::string<64>    message;
+    };
+
+    etl::vector<Entry, 64> entries;
+    size_t                 flush_calls;
+
+    CaptureSink() : flush_calls( 0 )
+    {
+      enabled  = true;
+      logLevel = mb::logging::Level::LVL_TRACE;
+    }
+
+    mb::logging::ErrCode open() final override
+    {
+      entries.clear();
+      flush_calls = 0;
+      return mb::logging::ErrCode::ERR_OK;
+    }
+
+    mb::logging::ErrCode close() final override
+    {
+      return mb::logging::ErrCode::ERR_OK;
+    }
+
+    mb::logging::ErrCode flush() final override
+    {
+      flush_calls++;
+      return mb::logging::ErrCode::ERR_OK;
+    }
+
+    mb::logging::ErrCode write( const mb::logging::Level level, const void *const message, const size_t length ) final override
+    {
+      if( !enabled || ( level < logLevel ) || !message || !length || entries.full() )
+      {
+        return mb::logging::ErrCode::ERR_FAIL;
+      }
+
+      entries.push_back( { level, etl::string<64>( static_cast<const char *>( message ), length ) } );
+      return mb::logging::ErrCode::ERR_OK;
+    }
+
+    void read( mb::logging::LogReader visitor, const bool direction ) final override
+    {
+      for( size_t i = 0; i < entries.size(); i++ )
+      {
+        const Entry &entry = direction ? entries[ i ] : entries[ entries.size() - 1 - i ];
+        if( visitor( entry.message.data(), entry.message.size() ) )
+        {
+          break;
+        }
+      }
+    }
+  };
+}    // namespace TestHarness
+
+#endif /* !MBEDUTILS_TEST_LOGGING_SINK_CAPTURE_HPP */
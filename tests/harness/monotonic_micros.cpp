@@ -0,0 +1,50 @@
+/******************************************************************************
+ *  File Name:
+ *    monotonic_micros.cpp
+ *
+ *  Description:
+ *    Real, strictly increasing mb::time::micros() for multi-threaded tests and
+ *    benchmarks that can't use per-call CppUMock time expectations.
+ *
+ *  2024 | Brandon Braun | brandonbraun653@protonmail.com
+ *****************************************************************************/
+
+/*-----------------------------------------------------------------------------
+Includes
+-----------------------------------------------------------------------------*/
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <mbedutils/interfaces/time_intf.hpp>
+
+namespace mb::time
+{
+  /*---------------------------------------------------------------------------
+  Public Functions
+  ---------------------------------------------------------------------------*/
+
+  /**
+   * @brief Microseconds since first use, taken from the host's steady clock.
+   *
+   * FlashDB rejects records whose timestamp does not advance, which a real
+   * clock cannot guarantee when several threads log within the same
+   * microsecond. Colliding readings are nudged forward by one tick instead.
+   */
+  int64_t micros()
+  {
+    static const auto           epoch = std::chrono::steady_clock::now();
+    static std::atomic<int64_t> last  = 0;
+
+    const int64_t now  = std::chrono::duration_cast<std::chrono::microseconds>( std::chrono::steady_clock::now() - epoch ).count();
+    int64_t       prev = last.load();
+    int64_t       next = 0;
+
+    do
+    {
+      next = std::max( now, prev + 1 );
+    } while( !last.compare_exchange_weak( prev, next ) );
+
+    return next;
+  }
+}    // namespace mb::time
@@ -0,0 +1,53 @@
+/******************************************************************************
+ *  File Name:
+ *    nor_device_config_comparator.hpp
+ *
+ *  Description:
+ *    CppUMock comparator for mb::memory::nor::DeviceConfig parameters
+ *
+ *  2024 | Brandon Braun | brandonbraun653@protonmail.com
+ *****************************************************************************/
+
+#pragma once
+#ifndef MBEDUTILS_TEST_NOR_DEVICE_CONFIG_COMPARATOR_HPP
+#define MBEDUTILS_TEST_NOR_DEVICE_CONFIG_COMPARATOR_HPP
+
+/*-----------------------------------------------------------------------------
+Includes
+-----------------------------------------------------------------------------*/
+#include <cstring>
+#include <mbedutils/drivers/memory/nvm/nor_flash.hpp>
+#include <CppUTestExt/MockSupport.h>
+
+namespace TestHarness
+{
+  /*---------------------------------------------------------------------------
+  Classes
+  ---------------------------------------------------------------------------*/
+
+  /**
+   * @brief Matches DeviceConfig mock parameters byte for byte.
+   *
+   * Install it in main() under the "mb::memory::nor::DeviceConfig" type name
+   * before running any test that passes a config through a mocked call.
+   */
+  class DeviceConfigComparator : public MockNamedValueComparator
+  {
+  public:
+    bool isEqual( const void *object1, const void *object2 ) override
+    {
+      const mb::memory::nor::DeviceConfig *config1 = static_cast<const mb::memory::nor::DeviceConfig *>( object1 );
+      const mb::memory::nor::DeviceConfig *config2 = static_cast<const mb::memory::nor::DeviceConfig *>( object2 );
+
+      return 0 == memcmp( config1, config2, sizeof( mb::memory::nor::DeviceConfig ) );
+    }
+
+    SimpleString valueToString( const void *object ) override
+    {
+      ( void )object;
+      return SimpleString( "DeviceConfig" );
+    }
+  };
+}    // namespace TestHarness
+
+#endif /* !MBEDUTILS_TEST_NOR_DEVICE_CONFIG_COMPARATOR_HPP */
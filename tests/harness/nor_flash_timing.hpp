@@ -0,0 +1,529 @@
+/******************************************************************************
+ *  File Name:
+ *    nor_flash_timing.hpp
+ *
+ *  Description:
+ *    Timing model that wraps the FileFlash fake so host tests can account for
+ *    realistic NOR program, erase, and bus transfer times.
+ *
+ *  2024 | Brandon Braun | brandonbraun653@protonmail.com
+ *****************************************************************************/
+
+#pragma once
+#ifndef MBEDUTILS_TEST_NOR_FLASH_TIMING_HPP
+#define MBEDUTILS_TEST_NOR_FLASH_TIMING_HPP
+
+/*-----------------------------------------------------------------------------
+Includes
+-----------------------------------------------------------------------------*/
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <mutex>
+#include <thread>
+#include <vector>
+#include <etl/vector.h>
+#include <mbedutils/drivers/memory/nvm/nor_flash.hpp>
+#include <CppUTest/TestHarness.h>
+#include <CppUTest/TestPlugin.h>
+#include "nor_flash_file.hpp"
+
+namespace TestHarness
+{
+  /*---------------------------------------------------------------------------
+  Enumerations
+  ---------------------------------------------------------------------------*/
+
+  enum class FlashTimingMode : uint8_t
+  {
+    VIRTUAL_CLOCK, /**< Accumulate simulated time only. Tests run at full speed. */
+    REAL_TIME,     /**< Also sleep the calling thread for the simulated time */
+  };
+
+  /*---------------------------------------------------------------------------
+  Structures
+  ---------------------------------------------------------------------------*/
+
+  struct FlashTiming
+  {
+    FlashTimingMode mode;          /**< How simulated time is applied */
+    size_t          spi_clock_hz;  /**< SPI bus clock, single data line */
+    size_t          cmd_overhead;  /**< Opcode + address bytes clocked per command */
+  };
+
+  struct FlashTimingStats
+  {
+    uint64_t bus_us;       /**< Time spent clocking bytes over the bus */
+    uint64_t write_us;     /**< Time spent waiting on page programs */
+    uint64_t erase_us;     /**< Time spent waiting on block/chip erases */
+    size_t   reads;        /**< Number of read transactions on the bus */
+    size_t   writes;       /**< Number of page programs */
+    size_t   erases;       /**< Number of block or chip erases */
+    size_t   cache_hits;   /**< Read cache pages served without the bus */
+    size_t   cache_misses; /**< Read cache pages fetched over the bus */
+
+    uint64_t total_us() const
+    {
+      return bus_us + write_us + erase_us;
+    }
+  };
+
+  /*---------------------------------------------------------------------------
+  Classes
+  ---------------------------------------------------------------------------*/
+
+  /**
+   * @brief Adds a latency model on top of fake::memory::nor::FileFlash.
+   *
+   * Bus time is derived from the SPI clock and the bytes each command moves.
+   * Program and erase times come from the DeviceConfig::dev_attr latencies,
+   * which are in milliseconds. Writes are costed per page, the same way the
+   * real driver splits them, and an erase covering the whole device is costed
+   * as a chip erase.
+   *
+   * An optional read cache model sits in front of the bus so the effect of
+   * the nor::DeviceDriver read cache can be measured against FlashDB traffic.
+   */
+  class TimedFileFlash
+  {
+  public:
+    TimedFileFlash() : mFlash( nullptr ), mCfg{}, mTiming{}, mCachePageSize( 0 ), mCacheTick( 0 )
+    {
+      reset();
+    }
+
+    /**
+     * @brief Attach the timing model to an opened FileFlash instance
+     *
+     * Statistics are left alone. FlashTimingReportPlugin clears them before
+     * each test, so setup traffic is still charged to the test that caused it.
+     *
+     * @param flash   Backing fake that stores the data
+     * @param cfg     Device configuration the fake was opened with
+     * @param timing  Bus and mode settings
+     */
+    void attach( fake::memory::nor::FileFlash *const flash, const mb::memory::nor::DeviceConfig &cfg,
+                 const FlashTiming &timing )
+    {
+      mFlash  = flash;
+      mCfg    = cfg;
+      mTiming = timing;
+    }
+
+    /**
+     * @brief Clear all accumulated statistics
+     */
+    void reset()
+    {
+      mBusUs       = 0;
+      mWriteUs     = 0;
+      mEraseUs     = 0;
+      mReads       = 0;
+      mWrites      = 0;
+      mErases      = 0;
+      mCacheHits   = 0;
+      mCacheMisses = 0;
+    }
+
+    /**
+     * @brief Model the nor::DeviceDriver read cache in front of the bus
+     *
+     * Reads are served in page_size pages. A miss fetches the whole page over
+     * the bus, pages are evicted least recently used first, and writes or
+     * erases drop the pages they touch. The cache always starts out cold.
+     *
+     * @param num_pages  Number of cached pages, zero disables the model
+     * @param page_size  Bytes per cached page
+     */
+    void enable_read_cache( const size_t num_pages, const size_t page_size )
+    {
+      std::lock_guard<std::mutex> lock( mCacheLock );
+
+      mCachePages.assign( page_size ? num_pages : 0, CachePage{ false, 0, 0 } );
+      mCachePageSize = page_size;
+      mCacheTick     = 0;
+    }
+
+    FlashTimingStats stats() const
+    {
+      return { mBusUs.load(),  mWriteUs.load(), mEraseUs.load(),   mReads.load(),
+               mWrites.load(), mErases.load(),  mCacheHits.load(), mCacheMisses.load() };
+    }
+
+    mb::memory::Status read( const uint64_t address, void *const data, const size_t length )
+    {
+      const mb::memory::Status result = mFlash->read( address, data, length );
+      if( result != mb::memory::Status::ERR_OK )
+      {
+        return result;
+      }
+
+      uint64_t bus_us = 0;
+
+      if( cache_enabled() )
+      {
+        bus_us = cache_read_time_us( address, length );
+      }
+      else
+      {
+        bus_us = bus_time_us( mTiming.cmd_overhead + length );
+        mReads++;
+      }
+
+      mBusUs += bus_us;
+      apply( bus_us );
+
+      return result;
+    }
+
+    mb::memory::Status write( const uint64_t address, const void *const data, const size_t length )
+    {
+      /*-----------------------------------------------------------------------
+      Drop cached pages even on failure, the array may be partly programmed
+      -----------------------------------------------------------------------*/
+      cache_invalidate( address, length );
+
+      const mb::memory::Status result = mFlash->write( address, data, length );
+      if( result != mb::memory::Status::ERR_OK )
+      {
+        return result;
+      }
+
+      /*-----------------------------------------------------------------------
+      Cost each page the driver would program separately
+      -----------------------------------------------------------------------*/
+      const size_t page_size = mCfg.dev_attr.write_size ? mCfg.dev_attr.write_size : length;
+      uint64_t     offset    = address;
+      size_t       remaining = length;
+      uint64_t     elapsed   = 0;
+
+      while( remaining )
+      {
+        const size_t chunk = std::min<size_t>( remaining, page_size - ( offset % page_size ) );
+
+        const uint64_t bus_us  = bus_time_us( mTiming.cmd_overhead + chunk );
+        const uint64_t prog_us = static_cast<uint64_t>( mCfg.dev_attr.write_latency ) * 1000u;
+
+        mWrites++;
+        mBusUs += bus_us;
+        mWriteUs += prog_us;
+        elapsed += bus_us + prog_us;
+
+        offset += chunk;
+        remaining -= chunk;
+      }
+
+      apply( elapsed );
+      return result;
+    }
+
+    mb::memory::Status erase( const uint64_t address, const size_t size )
+    {
+      cache_invalidate( address, size );
+
+      const mb::memory::Status result = mFlash->erase( address, size );
+      if( result != mb::memory::Status::ERR_OK )
+      {
+        return result;
+      }
+
+      /*-----------------------------------------------------------------------
+      Whole device erases use the chip erase latency, otherwise each block
+      pays its own command and erase time. An unaligned start still erases
+      the whole block it lands in.
+      -----------------------------------------------------------------------*/
+      uint64_t elapsed = 0;
+
+      if( size >= mCfg.dev_attr.size )
+      {
+        const uint64_t erase_us = static_cast<uint64_t>( mCfg.dev_attr.erase_chip_latency ) * 1000u;
+
+        mErases++;
+        mBusUs += bus_time_us( 1 );
+        mEraseUs += erase_us;
+        elapsed = bus_time_us( 1 ) + erase_us;
+      }
+      else
+      {
+        const size_t erase_size = mCfg.dev_attr.erase_size ? mCfg.dev_attr.erase_size : mCfg.dev_attr.block_size;
+        const size_t lead       = erase_size ? static_cast<size_t>( address % erase_size ) : 0;
+        const size_t num_blocks = erase_size ? ( ( lead + size + erase_size - 1 ) / erase_size ) : 1;
+
+        const uint64_t bus_us   = num_blocks * bus_time_us( mTiming.cmd_overhead );
+        const uint64_t erase_us = num_blocks * static_cast<uint64_t>( mCfg.dev_attr.erase_latency ) * 1000u;
+
+        mErases += num_blocks;
+        mBusUs += bus_us;
+        mEraseUs += erase_us;
+        elapsed = bus_us + erase_us;
+      }
+
+      apply( elapsed );
+      return result;
+    }
+
+  private:
+    struct CachePage
+    {
+      bool     valid;    /**< Page holds data */
+      uint64_t page;     /**< Page index within the device */
+      uint64_t last_use; /**< Access tick used for LRU eviction */
+    };
+
+    fake::memory::nor::FileFlash *mFlash;
+    mb::memory::nor::DeviceConfig mCfg;
+    FlashTiming                   mTiming;
+    std::atomic<uint64_t>         mBusUs;
+    std::atomic<uint64_t>         mWriteUs;
+    std::atomic<uint64_t>         mEraseUs;
+    std::atomic<size_t>           mReads;
+    std::atomic<size_t>           mWrites;
+    std::atomic<size_t>           mErases;
+    std::atomic<size_t>           mCacheHits;
+    std::atomic<size_t>           mCacheMisses;
+    std::mutex                    mCacheLock;
+    std::vector<CachePage>        mCachePages;
+    size_t                        mCachePageSize;
+    uint64_t                      mCacheTick;
+
+    uint64_t bus_time_us( const size_t bytes ) const
+    {
+      if( !mTiming.spi_clock_hz )
+      {
+        return 0;
+      }
+
+      return ( static_cast<uint64_t>( bytes ) * 8u * 1000000u ) / mTiming.spi_clock_hz;
+    }
+
+    bool cache_enabled()
+    {
+      std::lock_guard<std::mutex> lock( mCacheLock );
+      return !mCachePages.empty();
+    }
+
+    /**
+     * @brief Walks the pages a read touches and charges only the misses
+     *
+     * @param address  Start of the read
+     * @param length   Bytes to read
+     * @return uint64_t  Bus time spent fetching missed pages
+     */
+    uint64_t cache_read_time_us( const uint64_t address, const size_t length )
+    {
+      std::lock_guard<std::mutex> lock( mCacheLock );
+
+      if( !length )
+      {
+        return 0;
+      }
+
+      uint64_t       bus_us = 0;
+      const uint64_t first  = address / mCachePageSize;
+      const uint64_t last   = ( address + length - 1 ) / mCachePageSize;
+
+      for( uint64_t page = first; page <= last; page++ )
+      {
+        auto hit = std::find_if( mCachePages.begin(), mCachePages.end(),
+                                 [ page ]( const CachePage &p ) { return p.valid && ( p.page == page ); } );
+
+        if( hit != mCachePages.end() )
+        {
+          hit->last_use = ++mCacheTick;
+          mCacheHits++;
+          continue;
+        }
+
+        /*---------------------------------------------------------------------
+        Fill an empty slot first, otherwise the least recently used page
+        ---------------------------------------------------------------------*/
+        auto victim = std::min_element( mCachePages.begin(), mCachePages.end(),
+                                        []( const CachePage &a, const CachePage &b ) {
+                                          return ( a.valid ? a.last_use + 1 : 0 ) < ( b.valid ? b.last_use + 1 : 0 );
+                                        } );
+
+        *victim = { true, page, ++mCacheTick };
+        mCacheMisses++;
+        mReads++;
+        bus_us += bus_time_us( mTiming.cmd_overhead + mCachePageSize );
+      }
+
+      return bus_us;
+    }
+
+    /**
+     * @brief Drops every cached page that overlaps a programmed or erased range
+     */
+    void cache_invalidate( const uint64_t address, const size_t length )
+    {
+      std::lock_guard<std::mutex> lock( mCacheLock );
+
+      if( mCachePages.empty() || !length )
+      {
+        return;
+      }
+
+      const uint64_t first = address / mCachePageSize;
+      const uint64_t last  = ( address + length - 1 ) / mCachePageSize;
+
+      for( auto &p : mCachePages )
+      {
+        if( p.valid && ( p.page >= first ) && ( p.page <= last ) )
+        {
+          p.valid = false;
+        }
+      }
+    }
+
+    void apply( const uint64_t elapsed_us ) const
+    {
+      if( ( mTiming.mode == FlashTimingMode::REAL_TIME ) && elapsed_us )
+      {
+        std::this_thread::sleep_for( std::chrono::microseconds( elapsed_us ) );
+      }
+    }
+  };
+
+  /**
+   * @brief CppUTest plugin that reports simulated flash time for each test.
+   *
+   * Register every TimedFileFlash the test suite uses, then install the plugin
+   * in main(). Statistics are cleared before each test. A one line summary is
+   * printed after it only when MBEDUTILS_FLASH_TIMING_REPORT is set in the
+   * environment, so normal test output stays quiet.
+   */
+  class FlashTimingReportPlugin : public TestPlugin
+  {
+  public:
+    FlashTimingReportPlugin() :
+        TestPlugin( "FlashTimingReport" ), mReport( std::getenv( "MBEDUTILS_FLASH_TIMING_REPORT" ) != nullptr )
+    {
+    }
+
+    /**
+     * @brief Adds a flash to the per-test reset and report
+     *
+     * Aborts if the tracking list is already full. Silently dropping a flash
+     * would leave its statistics running across tests.
+     */
+    void track( TimedFileFlash *const flash )
+    {
+      if( mFlashes.full() )
+      {
+        fprintf( stderr, "FlashTimingReportPlugin: cannot track more than %zu flashes\n", mFlashes.capacity() );
+        std::abort();
+      }
+
+      mFlashes.push_back( flash );
+    }
+
+    void preTestAction( UtestShell &, TestResult & ) override
+    {
+      for( auto flash : mFlashes )
+      {
+        flash->reset();
+      }
+    }
+
+    void postTestAction( UtestShell &test, TestResult & ) override
+    {
+      if( !mReport )
+      {
+        return;
+      }
+
+      FlashTimingStats total = {};
+
+      for( auto flash : mFlashes )
+      {
+        const FlashTimingStats s = flash->stats();
+        total.bus_us += s.bus_us;
+        total.write_us += s.write_us;
+        total.erase_us += s.erase_us;
+        total.reads += s.reads;
+        total.writes += s.writes;
+        total.erases += s.erases;
+        total.cache_hits += s.cache_hits;
+        total.cache_misses += s.cache_misses;
+      }
+
+      printf( "\n[flash] %s.%s: %.3f ms simulated (bus %.3f, program %.3f, erase %.3f) r/w/e %zu/%zu/%zu",
+              test.getGroup().asCharString(), test.getName().asCharString(), total.total_us() / 1000.0,
+              total.bus_us / 1000.0, total.write_us / 1000.0, total.erase_us / 1000.0, total.reads, total.writes,
+              total.erases );
+
+      if( total.cache_hits || total.cache_misses )
+      {
+        printf( " cache h/m %zu/%zu", total.cache_hits, total.cache_misses );
+      }
+    }
+
+  private:
+    etl::vector<TimedFileFlash *, 4> mFlashes;
+    bool                             mReport;
+  };
+
+  /*---------------------------------------------------------------------------
+  Constants
+  ---------------------------------------------------------------------------*/
+
+  /**
+   * @brief 50MHz single-lane SPI, charged in virtual time
+   */
+  static constexpr FlashTiming s_flash_timing = {
+    .mode         = FlashTimingMode::VIRTUAL_CLOCK,
+    .spi_clock_hz = 50000000,
+    .cmd_overhead = 4,
+  };
+
+  /*---------------------------------------------------------------------------
+  Shared Instances
+  ---------------------------------------------------------------------------*/
+
+  /**
+   * @brief Timing wrappers for the fal devices of FileFlash-backed suites
+   */
+  inline TimedFileFlash s_flash_0_timed;
+  inline TimedFileFlash s_flash_1_timed;
+
+  /*---------------------------------------------------------------------------
+  Public Functions
+  ---------------------------------------------------------------------------*/
+
+  /**
+   * @brief Whether the suites should run with the timed device attributes
+   *
+   * Enabled by the same MBEDUTILS_FLASH_TIMING_REPORT environment variable
+   * that turns on FlashTimingReportPlugin output.
+   */
+  inline bool flash_timing_enabled()
+  {
+    return std::getenv( "MBEDUTILS_FLASH_TIMING_REPORT" ) != nullptr;
+  }
+
+  /**
+   * @brief Sets the geometry and latencies the timing model charges against
+   *
+   * Models a part with erase blocks of block_size and 256 byte pages.
+   *
+   * @param cfg         Configuration to fill
+   * @param block_size  Erase block size of the fal device
+   * @param size        Total size of the fal device
+   */
+  inline void configure_timed_flash( mb::memory::nor::DeviceConfig &cfg, const size_t block_size, const size_t size )
+  {
+    cfg.dev_attr.block_size         = block_size;
+    cfg.dev_attr.size               = size;
+    cfg.dev_attr.erase_size         = block_size;
+    cfg.dev_attr.write_size         = 256;
+    cfg.dev_attr.write_latency      = 1;
+    cfg.dev_attr.erase_latency      = 60;
+    cfg.dev_attr.erase_chip_latency = 30000;
+  }
+}    // namespace TestHarness
+
+#endif /* !MBEDUTILS_TEST_NOR_FLASH_TIMING_HPP */
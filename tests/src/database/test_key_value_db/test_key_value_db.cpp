@@ -33,9 +33,14 @@ Includes
 #include "nor_flash_file.hpp"
 #include "test_kv_db_harness.hpp"
 
+#include <tests/harness/nor_flash_timing.hpp>
+
 
 using namespace mb::db;
 using namespace CppUMockGen;
+using TestHarness::s_flash_0_timed;
+using TestHarness::s_flash_1_timed;
+using TestHarness::s_flash_timing;
 
 /*-----------------------------------------------------------------------------
 Static Data
@@ -55,13 +60,13 @@ extern "C"
     .ops      = {
              .init = []( void ) -> int { return 0; },
         .read                        = []( long offset, uint8_t *buf, size_t size ) -> int {
-          return ( mb::memory::Status::ERR_OK == s_flash_0_driver->read( offset, buf, size ) ) ? 0 : -1;
+          return ( mb::memory::Status::ERR_OK == s_flash_0_timed.read( offset, buf, size ) ) ? 0 : -1;
         },
         .write                       = []( long offset, const uint8_t *buf, size_t size ) -> int {
-          return ( mb::memory::Status::ERR_OK == s_flash_0_driver->write( offset, buf, size ) ) ? 0 : -1;
+          return ( mb::memory::Status::ERR_OK == s_flash_0_timed.write( offset, buf, size ) ) ? 0 : -1;
         },
         .erase                       = []( long offset, size_t size ) -> int {
-          return ( mb::memory::Status::ERR_OK == s_flash_0_driver->erase( offset, size ) ) ? 0 : -1;
+          return ( mb::memory::Status::ERR_OK == s_flash_0_timed.erase( offset, size ) ) ? 0 : -1;
         },
     },
     .write_gran                      = 1
@@ -75,13 +80,13 @@ extern "C"
     .ops      = {
              .init = []( void ) -> int { return 0; },
         .read                        = []( long offset, uint8_t *buf, size_t size ) -> int {
-          return ( mb::memory::Status::ERR_OK == s_flash_1_driver->read( offset, buf, size ) ) ? 0 : -1;
+          return ( mb::memory::Status::ERR_OK == s_flash_1_timed.read( offset, buf, size ) ) ? 0 : -1;
         },
         .write                       = []( long offset, const uint8_t *buf, size_t size ) -> int {
-          return ( mb::memory::Status::ERR_OK == s_flash_1_driver->write( offset, buf, size ) ) ? 0 : -1;
+          return ( mb::memory::Status::ERR_OK == s_flash_1_timed.write( offset, buf, size ) ) ? 0 : -1;
         },
         .erase                       = []( long offset, size_t size ) -> int {
-          return ( mb::memory::Status::ERR_OK == s_flash_1_driver->erase( offset, size ) ) ? 0 : -1;
+          return ( mb::memory::Status::ERR_OK == s_flash_1_timed.erase( offset, size ) ) ? 0 : -1;
         },
     },
     .write_gran                      = 1
@@ -94,6 +99,11 @@ Tests
 
 int main( int argc, char **argv )
 {
+  TestHarness::FlashTimingReportPlugin flash_timing;
+  flash_timing.track( &s_flash_0_timed );
+  flash_timing.track( &s_flash_1_timed );
+  TestRegistry::getCurrentRegistry()->installPlugin( &flash_timing );
+
   return RUN_ALL_TESTS( argc, argv );
 }
 
@@ -741,15 +751,27 @@ TEST_GROUP( db_kv_nvm )
     flash_0_cfg.dev_attr.block_size = fdb_nor_flash0.blk_size;
     flash_0_cfg.dev_attr.size       = fdb_nor_flash0.len;
 
+    if( TestHarness::flash_timing_enabled() )
+    {
+      TestHarness::configure_timed_flash( flash_0_cfg, fdb_nor_flash0.blk_size, fdb_nor_flash0.len );
+    }
+
     std::remove( "flash_0_test.bin" );
     s_flash_0_driver->open( "flash_0_test.bin", flash_0_cfg );
+    s_flash_0_timed.attach( s_flash_0_driver, flash_0_cfg, s_flash_timing );
 
     mb::memory::nor::DeviceConfig flash_1_cfg;
     flash_1_cfg.dev_attr.block_size = fdb_nor_flash1.blk_size;
     flash_1_cfg.dev_attr.size       = fdb_nor_flash1.len;
 
+    if( TestHarness::flash_timing_enabled() )
+    {
+      TestHarness::configure_timed_flash( flash_1_cfg, fdb_nor_flash1.blk_size, fdb_nor_flash1.len );
+    }
+
     std::remove( "flash_1_test.bin" );
     s_flash_1_driver->open( "flash_1_test.bin", flash_1_cfg );
+    s_flash_1_timed.attach( s_flash_1_driver, flash_1_cfg, s_flash_timing );
 
     /*-------------------------------------------------------------------------
     Inject some default KV test nodes
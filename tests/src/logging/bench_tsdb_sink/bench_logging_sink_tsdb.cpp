@@ -0,0 +1,644 @@
+/******************************************************************************
+ *  File Name:
+ *    bench_logging_sink_tsdb.cpp
+ *
+ *  Description:
+ *    Throughput and latency benchmark for the TimeSeries Database logging
+ *    sink. Drives TSDBSink on top of FileFlash with a configurable message
+ *    size, per-thread message rate and thread count, then reports msgs/sec,
+ *    bytes/sec, write() latency percentiles and sector rollover spikes as
+ *    JSON. A second mode compares batched and compressed storage.
+ *
+ *  2024 | Brandon Braun | brandonbraun653@protonmail.com
+ *****************************************************************************/
+
+/*-----------------------------------------------------------------------------
+Includes
+-----------------------------------------------------------------------------*/
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <memory>
+#include <thread>
+#include <vector>
+#include <mbedutils/database.hpp>
+#include <mbedutils/logging.hpp>
+
+#include <CppUTestExt/MockSupport.h>
+
+#include "nor_flash_file.hpp"
+
+/*-----------------------------------------------------------------------------
+Structures
+-----------------------------------------------------------------------------*/
+
+/**
+ * @brief Benchmark parameters, settable from the command line
+ */
+struct BenchConfig
+{
+  size_t      msg_size = 64;    /**< Bytes per log message */
+  size_t      rate     = 0;     /**< Messages per second per thread, 0 == unthrottled */
+  size_t      threads  = 1;     /**< Number of concurrent writer threads */
+  size_t      count    = 20000; /**< Messages written by each thread */
+  const char *mode     = "write"; /**< Benchmark to run: "write" or "compression" */
+  const char *output   = nullptr; /**< JSON output file, stdout if null */
+};
+
+/**
+ * @brief Timing of a single TSDBSink::write() call
+ */
+struct WriteSample
+{
+  uint32_t latency_ns; /**< Time spent inside write() */
+  bool     rollover;   /**< FlashDB moved to a new sector or erased during the call */
+  bool     ok;         /**< write() returned ERR_OK */
+};
+
+/**
+ * @brief Latency percentiles of a set of samples
+ */
+struct LatencySummary
+{
+  size_t count;
+  double p50_us;
+  double p99_us;
+  double max_us;
+};
+
+/*-----------------------------------------------------------------------------
+Static Data
+-----------------------------------------------------------------------------*/
+
+static fake::memory::nor::FileFlash *s_flash_0_driver;
+static std::atomic<size_t>           s_flash_bytes_written = 0;
+static std::atomic<size_t>           s_flash_erases        = 0;
+static std::atomic<size_t>           s_sector_changes      = 0;
+static std::atomic<long>             s_last_write_sector   = -1;
+
+/* Flash activity caused by the calling thread's own write() call. FlashDB runs
+   on the writer's thread under the sink lock, so these never see another
+   thread's rollover. */
+static thread_local size_t t_flash_erases   = 0;
+static thread_local size_t t_sector_changes = 0;
+
+extern "C"
+{
+  const fal_flash_dev fdb_nor_flash0 = {
+    .name     = "nor_flash_0",
+    .addr     = 0x00000000,
+    .len      = 8 * 1024 * 1024,
+    .blk_size = 4096,
+    .ops      = {
+             .init = []( void ) -> int { return 0; },
+        .read                        = []( long offset, uint8_t *buf, size_t size ) -> int {
+          return ( mb::memory::Status::ERR_OK == s_flash_0_driver->read( offset, buf, size ) ) ? 0 : -1;
+        },
+        .write                       = []( long offset, const uint8_t *buf, size_t size ) -> int {
+          const long sector = offset / 4096;
+          if( s_last_write_sector.exchange( sector ) != sector )
+          {
+            s_sector_changes++;
+            t_sector_changes++;
+          }
+
+          s_flash_bytes_written += size;
+          return ( mb::memory::Status::ERR_OK == s_flash_0_driver->write( offset, buf, size ) ) ? 0 : -1;
+        },
+        .erase                       = []( long offset, size_t size ) -> int {
+          s_flash_erases++;
+          t_flash_erases++;
+          return ( mb::memory::Status::ERR_OK == s_flash_0_driver->erase( offset, size ) ) ? 0 : -1;
+        },
+    },
+    .write_gran                      = 1
+  };
+}
+
+/*-----------------------------------------------------------------------------
+Static Functions
+-----------------------------------------------------------------------------*/
+
+/**
+ * @brief Prints command line usage
+ *
+ * @param name  Executable name
+ */
+static void print_usage( const char *name )
+{
+  fprintf( stderr,
+           "Usage: %s [options]\n"
+           "  --msg-size <bytes>   Size of each log message (default 64)\n"
+           "  --rate <msgs/sec>    Per-thread write rate, 0 for unthrottled (default 0)\n"
+           "  --threads <count>    Number of writer threads (default 1)\n"
+           "  --count <msgs>       Messages written by each thread (default 20000)\n"
+           "  --mode <name>        write or compression (default write)\n"
+           "  --output <file>      Write the JSON report here instead of stdout\n",
+           name );
+}
+
+/**
+ * @brief Parses the command line into a benchmark configuration
+ *
+ * @param argc    Number of arguments
+ * @param argv    Argument list
+ * @param cfg     Configuration to fill
+ * @return bool   True if the arguments were valid
+ */
+static bool parse_args( int argc, char **argv, BenchConfig &cfg )
+{
+  for( int i = 1; i < argc; i++ )
+  {
+    const char *arg   = argv[ i ];
+    const char *value = ( i + 1 < argc ) ? argv[ i + 1 ] : nullptr;
+
+    if( !value )
+    {
+      return false;
+    }
+
+    if( strcmp( arg, "--msg-size" ) == 0 )
+    {
+      cfg.msg_size = strtoul( value, nullptr, 0 );
+    }
+    else if( strcmp( arg, "--rate" ) == 0 )
+    {
+      cfg.rate = strtoul( value, nullptr, 0 );
+    }
+    else if( strcmp( arg, "--threads" ) == 0 )
+    {
+      cfg.threads = strtoul( value, nullptr, 0 );
+    }
+    else if( strcmp( arg, "--count" ) == 0 )
+    {
+      cfg.count = strtoul( value, nullptr, 0 );
+    }
+    else if( strcmp( arg, "--mode" ) == 0 )
+    {
+      cfg.mode = value;
+    }
+    else if( strcmp( arg, "--output" ) == 0 )
+    {
+      cfg.output = value;
+    }
+    else
+    {
+      return false;
+    }
+
+    i++;
+  }
+
+  return ( cfg.msg_size > 0 ) && ( cfg.threads > 0 ) && ( cfg.count > 0 );
+}
+
+/**
+ * @brief Computes latency percentiles over a set of samples
+ *
+ * @param latencies_ns  Samples in nanoseconds, sorted in place
+ * @return LatencySummary
+ */
+static LatencySummary summarize( std::vector<uint32_t> &latencies_ns )
+{
+  LatencySummary summary = { latencies_ns.size(), 0.0, 0.0, 0.0 };
+  if( latencies_ns.empty() )
+  {
+    return summary;
+  }
+
+  std::sort( latencies_ns.begin(), latencies_ns.end() );
+
+  auto percentile = [ & ]( const double q ) -> double {
+    const size_t idx = std::min( latencies_ns.size() - 1, static_cast<size_t>( q * latencies_ns.size() ) );
+    return latencies_ns[ idx ] / 1000.0;
+  };
+
+  summary.p50_us = percentile( 0.50 );
+  summary.p99_us = percentile( 0.99 );
+  summary.max_us = latencies_ns.back() / 1000.0;
+
+  return summary;
+}
+
+/**
+ * @brief Body of a single writer thread
+ *
+ * @param sink      Sink under test
+ * @param cfg       Benchmark configuration
+ * @param thread_id Index of this thread, embedded in each message
+ * @param samples   Output storage for per-write timing, pre-sized to cfg.count
+ */
+static void writer_thread( mb::logging::TSDBSink *sink, const BenchConfig &cfg, const size_t thread_id,
+                           std::vector<WriteSample> &samples )
+{
+  using clock = std::chrono::steady_clock;
+
+  std::vector<char> message( cfg.msg_size, 'x' );
+  const auto        period = cfg.rate ? std::chrono::nanoseconds( 1000000000ull / cfg.rate ) : std::chrono::nanoseconds( 0 );
+  auto              next   = clock::now();
+
+  for( size_t i = 0; i < cfg.count; i++ )
+  {
+    /*-------------------------------------------------------------------------
+    Pace the writes if a rate was requested
+    -------------------------------------------------------------------------*/
+    if( cfg.rate )
+    {
+      std::this_thread::sleep_until( next );
+      next += period;
+    }
+
+    /*-------------------------------------------------------------------------
+    Stamp the message so records are distinguishable in the partition
+    -------------------------------------------------------------------------*/
+    const int hdr = snprintf( message.data(), message.size(), "t%zu:%zu ", thread_id, i );
+    if( ( hdr > 0 ) && ( static_cast<size_t>( hdr ) < message.size() ) )
+    {
+      message[ hdr ] = ' ';
+    }
+
+    /*-------------------------------------------------------------------------
+    Time the write and note whether FlashDB crossed into another sector
+    during this call. Only this thread's counters are used: a writer that was
+    merely blocked behind another thread's rollover is not a rollover itself.
+    -------------------------------------------------------------------------*/
+    const size_t sectors_before = t_sector_changes;
+    const size_t erases_before  = t_flash_erases;
+    const auto   start          = clock::now();
+
+    const auto result = sink->write( mb::logging::Level::LVL_INFO, message.data(), message.size() );
+
+    const auto stop = clock::now();
+
+    samples[ i ].latency_ns = static_cast<uint32_t>( std::chrono::duration_cast<std::chrono::nanoseconds>( stop - start ).count() );
+    samples[ i ].rollover   = ( t_sector_changes != sectors_before ) || ( t_flash_erases != erases_before );
+    samples[ i ].ok         = ( result == mb::logging::ErrCode::ERR_OK );
+  }
+}
+
+/**
+ * @brief Emits a latency summary as a JSON object
+ *
+ * @param out     Output stream
+ * @param name    Key for the object
+ * @param summary Data to emit
+ */
+static void print_latency( FILE *out, const char *name, const LatencySummary &summary )
+{
+  fprintf( out, "    \"%s\": { \"count\": %zu, \"p50_us\": %.3f, \"p99_us\": %.3f, \"max_us\": %.3f }", name, summary.count,
+           summary.p50_us, summary.p99_us, summary.max_us );
+}
+
+/**
+ * @brief Creates a fresh, empty backing file for the flash device
+ */
+static void open_flash()
+{
+  s_flash_0_driver = new fake::memory::nor::FileFlash();
+
+  mb::memory::nor::DeviceConfig flash_0_cfg;
+  flash_0_cfg.dev_attr.block_size = fdb_nor_flash0.blk_size;
+  flash_0_cfg.dev_attr.size       = fdb_nor_flash0.len;
+
+  std::remove( "flash_0_bench.bin" );
+  s_flash_0_driver->open( "flash_0_bench.bin", flash_0_cfg );
+}
+
+/**
+ * @brief Releases the flash device created by open_flash()
+ */
+static void close_flash()
+{
+  s_flash_0_driver->close();
+  delete s_flash_0_driver;
+  s_flash_0_driver = nullptr;
+}
+
+#if defined( MBEDUTILS_BENCH_TSDB_COMPRESSION )
+/**
+ * @brief Outcome of writing and reading back one storage configuration
+ */
+struct CompressionPhase
+{
+  size_t input_bytes; /**< Message bytes accepted by write() */
+  size_t flash_bytes; /**< Bytes programmed into flash, partition format excluded */
+  size_t read_msgs;   /**< Messages handed back by read() */
+  size_t read_bytes;  /**< Message bytes handed back by read() */
+  double write_sec;   /**< Wall time for all write() calls plus the final flush() */
+  double read_sec;    /**< Wall time for a full forward read() */
+};
+
+static size_t s_read_msgs  = 0;
+static size_t s_read_bytes = 0;
+
+static bool cb_read_count( const void *const message, const size_t length )
+{
+  ( void )message;
+  s_read_msgs++;
+  s_read_bytes += length;
+  return false; // Keep reading the next log
+}
+
+/**
+ * @brief Writes a repetitive, but not identical, stream of log lines
+ *
+ * @param sink      Sink to write into
+ * @param count     Number of messages to write
+ * @return size_t   Total number of message bytes handed to the sink
+ */
+static size_t write_repetitive_logs( mb::logging::TSDBSink *sink, const size_t count )
+{
+  char   message[ 64 ];
+  size_t total = 0;
+
+  for( size_t i = 0; i < count; i++ )
+  {
+    const int len = snprintf( message, sizeof( message ), "[sensor] channel %zu sample %zu status=OK", i % 4, i );
+    if( sink->write( mb::logging::Level::LVL_INFO, message, len ) == mb::logging::ErrCode::ERR_OK )
+    {
+      total += len;
+    }
+  }
+
+  return total;
+}
+
+/**
+ * @brief Writes cfg.count messages into a fresh partition, then reads them back
+ *
+ * @param cfg         Benchmark configuration
+ * @param compress    Whether to compress each committed batch
+ * @param phase       Output: measurements
+ * @return bool       True if the sink opened and every message was read back
+ */
+static bool run_compression_phase( const BenchConfig &cfg, const bool compress, CompressionPhase &phase )
+{
+  using clock = std::chrono::steady_clock;
+
+  open_flash();
+
+  auto reader_buffer = std::make_unique<uint8_t[]>( 2048 );
+  auto batch_buffer  = std::make_unique<uint8_t[]>( 1024 );
+  auto sink          = std::make_unique<mb::logging::TSDBSink>();
+
+  mb::logging::TSDBSink::Config sink_cfg;
+  sink_cfg.dev_name      = "nor_flash_0";
+  sink_cfg.part_name     = "logging";
+  sink_cfg.max_log_size  = 1024;
+  sink_cfg.reader_buffer = reader_buffer.get();
+  sink_cfg.batch_buffer  = batch_buffer.get();
+  sink_cfg.compress      = compress;
+
+  sink->configure( sink_cfg );
+  sink->enabled  = true;
+  sink->logLevel = mb::logging::Level::LVL_TRACE;
+
+  if( sink->open() != mb::logging::ErrCode::ERR_OK )
+  {
+    close_flash();
+    return false;
+  }
+
+  s_flash_bytes_written = 0;
+
+  /*---------------------------------------------------------------------------
+  Ingest: every write() plus the flush that commits the final batch
+  ---------------------------------------------------------------------------*/
+  auto start        = clock::now();
+  phase.input_bytes = write_repetitive_logs( sink.get(), cfg.count );
+  sink->flush();
+  auto stop = clock::now();
+
+  phase.write_sec   = std::chrono::duration<double>( stop - start ).count();
+  phase.flash_bytes = s_flash_bytes_written;
+
+  /*---------------------------------------------------------------------------
+  Read back: includes reading flash and, when enabled, decompression
+  ---------------------------------------------------------------------------*/
+  s_read_msgs  = 0;
+  s_read_bytes = 0;
+
+  start = clock::now();
+  sink->read( mb::logging::LogReader::create<cb_read_count>(), true );
+  stop = clock::now();
+
+  phase.read_sec   = std::chrono::duration<double>( stop - start ).count();
+  phase.read_msgs  = s_read_msgs;
+  phase.read_bytes = s_read_bytes;
+
+  sink->close();
+  sink.reset();
+  close_flash();
+
+  return phase.read_msgs == cfg.count;
+}
+
+/**
+ * @brief Emits one compression phase as a JSON object
+ *
+ * @param out     Output stream
+ * @param name    Key for the object
+ * @param phase   Data to emit
+ */
+static void print_phase( FILE *out, const char *name, const CompressionPhase &phase )
+{
+  const double mb = 1024.0 * 1024.0;
+
+  fprintf( out,
+           "    \"%s\": { \"flash_bytes\": %zu, \"read_msgs\": %zu, \"write_mb_per_sec\": %.3f, "
+           "\"read_mb_per_sec\": %.3f }",
+           name, phase.flash_bytes, phase.read_msgs, ( phase.input_bytes / mb ) / phase.write_sec,
+           ( phase.read_bytes / mb ) / phase.read_sec );
+}
+
+/**
+ * @brief Compares batched and batched + compressed storage of the same stream
+ *
+ * @param cfg   Benchmark configuration
+ * @return int  Process exit code
+ */
+static int run_compression_bench( const BenchConfig &cfg )
+{
+  CompressionPhase batched    = {};
+  CompressionPhase compressed = {};
+
+  const bool batched_ok    = run_compression_phase( cfg, false, batched );
+  const bool compressed_ok = run_compression_phase( cfg, true, compressed );
+
+  FILE *out = cfg.output ? fopen( cfg.output, "w" ) : stdout;
+  if( !out )
+  {
+    fprintf( stderr, "Unable to open %s\n", cfg.output );
+    return -1;
+  }
+
+  fprintf( out, "{\n" );
+  fprintf( out, "  \"config\": { \"mode\": \"compression\", \"count\": %zu },\n", cfg.count );
+  fprintf( out, "  \"results\": {\n" );
+  fprintf( out, "    \"input_bytes\": %zu,\n", compressed.input_bytes );
+  print_phase( out, "batched", batched );
+  fprintf( out, ",\n" );
+  print_phase( out, "compressed", compressed );
+  fprintf( out, ",\n" );
+  fprintf( out, "    \"ratio_vs_input\": %.3f,\n", static_cast<double>( compressed.input_bytes ) / compressed.flash_bytes );
+  fprintf( out, "    \"ratio_vs_batched\": %.3f\n", static_cast<double>( batched.flash_bytes ) / compressed.flash_bytes );
+  fprintf( out, "  }\n}\n" );
+
+  if( out != stdout )
+  {
+    fclose( out );
+  }
+
+  return ( batched_ok && compressed_ok ) ? 0 : -1;
+}
+#endif /* MBEDUTILS_BENCH_TSDB_COMPRESSION */
+
+/*-----------------------------------------------------------------------------
+Public Functions
+-----------------------------------------------------------------------------*/
+
+int main( int argc, char **argv )
+{
+  BenchConfig cfg;
+  if( !parse_args( argc, argv, cfg ) )
+  {
+    print_usage( argv[ 0 ] );
+    return -1;
+  }
+
+  /*---------------------------------------------------------------------------
+  Only the assert/atexit/logging plumbing is still mocked. Let it run freely.
+  ---------------------------------------------------------------------------*/
+  mock().ignoreOtherCalls();
+
+#if defined( MBEDUTILS_BENCH_TSDB_COMPRESSION )
+  if( strcmp( cfg.mode, "compression" ) == 0 )
+  {
+    return run_compression_bench( cfg );
+  }
+#endif
+
+  if( strcmp( cfg.mode, "write" ) != 0 )
+  {
+    print_usage( argv[ 0 ] );
+    return -1;
+  }
+
+  /*---------------------------------------------------------------------------
+  Configure the flash device
+  ---------------------------------------------------------------------------*/
+  open_flash();
+
+  /*---------------------------------------------------------------------------
+  Configure the sink
+  ---------------------------------------------------------------------------*/
+  auto sink = std::make_unique<mb::logging::TSDBSink>();
+
+  mb::logging::TSDBSink::Config sink_cfg;
+  sink_cfg.dev_name      = "nor_flash_0";
+  sink_cfg.part_name     = "logging";
+  sink_cfg.max_log_size  = std::max<size_t>( cfg.msg_size, 256 );
+  sink_cfg.reader_buffer = nullptr;
+
+  sink->configure( sink_cfg );
+  sink->enabled  = true;
+  sink->logLevel = mb::logging::Level::LVL_TRACE;
+
+  if( sink->open() != mb::logging::ErrCode::ERR_OK )
+  {
+    fprintf( stderr, "Failed to open TSDBSink\n" );
+    return -1;
+  }
+
+  /* Don't count partition formatting as part of the measurement */
+  s_flash_bytes_written = 0;
+  s_flash_erases        = 0;
+  s_sector_changes      = 0;
+
+  /*---------------------------------------------------------------------------
+  Run the writers
+  ---------------------------------------------------------------------------*/
+  std::vector<std::vector<WriteSample>> samples( cfg.threads, std::vector<WriteSample>( cfg.count ) );
+  std::vector<std::thread>              workers;
+
+  const auto start = std::chrono::steady_clock::now();
+
+  for( size_t t = 0; t < cfg.threads; t++ )
+  {
+    workers.emplace_back( writer_thread, sink.get(), std::cref( cfg ), t, std::ref( samples[ t ] ) );
+  }
+
+  for( auto &worker : workers )
+  {
+    worker.join();
+  }
+
+  const auto   stop        = std::chrono::steady_clock::now();
+  const double elapsed_sec = std::chrono::duration<double>( stop - start ).count();
+
+  sink->close();
+  close_flash();
+
+  /*---------------------------------------------------------------------------
+  Reduce the results
+  ---------------------------------------------------------------------------*/
+  std::vector<uint32_t> all_latencies;
+  std::vector<uint32_t> rollover_latencies;
+  size_t                num_ok = 0;
+
+  all_latencies.reserve( cfg.threads * cfg.count );
+  for( const auto &thread_samples : samples )
+  {
+    for( const auto &sample : thread_samples )
+    {
+      all_latencies.push_back( sample.latency_ns );
+      if( sample.rollover )
+      {
+        rollover_latencies.push_back( sample.latency_ns );
+      }
+
+      num_ok += sample.ok ? 1 : 0;
+    }
+  }
+
+  const LatencySummary all_summary      = summarize( all_latencies );
+  const LatencySummary rollover_summary = summarize( rollover_latencies );
+
+  /*---------------------------------------------------------------------------
+  Report
+  ---------------------------------------------------------------------------*/
+  FILE *out = cfg.output ? fopen( cfg.output, "w" ) : stdout;
+  if( !out )
+  {
+    fprintf( stderr, "Unable to open %s\n", cfg.output );
+    return -1;
+  }
+
+  fprintf( out, "{\n" );
+  fprintf( out, "  \"config\": { \"msg_size\": %zu, \"rate\": %zu, \"threads\": %zu, \"count\": %zu },\n", cfg.msg_size,
+           cfg.rate, cfg.threads, cfg.count );
+  fprintf( out, "  \"results\": {\n" );
+  fprintf( out, "    \"messages\": %zu,\n", num_ok );
+  fprintf( out, "    \"failed\": %zu,\n", all_latencies.size() - num_ok );
+  fprintf( out, "    \"elapsed_sec\": %.6f,\n", elapsed_sec );
+  fprintf( out, "    \"msgs_per_sec\": %.1f,\n", num_ok / elapsed_sec );
+  fprintf( out, "    \"bytes_per_sec\": %.1f,\n", ( num_ok * cfg.msg_size ) / elapsed_sec );
+  fprintf( out, "    \"flash_bytes_written\": %zu,\n", s_flash_bytes_written.load() );
+  fprintf( out, "    \"flash_erases\": %zu,\n", s_flash_erases.load() );
+  print_latency( out, "write_latency", all_summary );
+  fprintf( out, ",\n" );
+  print_latency( out, "rollover_latency", rollover_summary );
+  fprintf( out, "\n  }\n}\n" );
+
+  if( out != stdout )
+  {
+    fclose( out );
+  }
+
+  return ( num_ok == all_latencies.size() ) ? 0 : -1;
+}
@@ -0,0 +1,461 @@
+/******************************************************************************
+ *  File Name:
+ *    test_logging_router.cpp
+ *
+ *  Description:
+ *    Test cases for the multi-sink logging router.
+ *
+ *  2024 | Brandon Braun | brandonbraun653@protonmail.com
+ *****************************************************************************/
+
+/*-----------------------------------------------------------------------------
+Includes
+-----------------------------------------------------------------------------*/
+
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <future>
+#include <mbedutils/logging.hpp>
+#include <mutex>
+#include <thread>
+
+#include <CppUTest/TestHarness.h>
+#include <CppUTestExt/MockSupport.h>
+#include <CppUTest/CommandLineTestRunner.h>
+
+#include <tests/harness/logging_sink_capture.hpp>
+
+using namespace mb::logging;
+
+/*-----------------------------------------------------------------------------
+Constants
+-----------------------------------------------------------------------------*/
+
+static constexpr auto TEST_TIMEOUT = std::chrono::seconds( 5 );
+
+/*-----------------------------------------------------------------------------
+Static Functions
+-----------------------------------------------------------------------------*/
+
+/**
+ * @brief Polls a condition until it holds or the test timeout expires
+ *
+ * @param predicate   Condition to wait on
+ * @return bool       True if the condition was met in time
+ */
+template<typename Predicate>
+static bool wait_until( Predicate predicate )
+{
+  const auto deadline = std::chrono::steady_clock::now() + TEST_TIMEOUT;
+  while( !predicate() )
+  {
+    if( std::chrono::steady_clock::now() > deadline )
+    {
+      return false;
+    }
+    std::this_thread::sleep_for( std::chrono::microseconds( 100 ) );
+  }
+
+  return true;
+}
+
+/*-----------------------------------------------------------------------------
+Classes
+-----------------------------------------------------------------------------*/
+
+/**
+ * @brief Sink whose write() stalls until released, like a NOR erase in progress.
+ *
+ * Messages are forwarded to a CaptureSink once the stall ends. The stall is
+ * bounded by the test timeout so a broken router can't hang the test binary.
+ */
+class StallingSink : public SinkInterface
+{
+public:
+  TestHarness::CaptureSink capture;
+
+  StallingSink() : mStalled( true ), mInWrite( false )
+  {
+    enabled  = true;
+    logLevel = Level::LVL_TRACE;
+  }
+
+  ErrCode open() final override
+  {
+    return capture.open();
+  }
+
+  ErrCode close() final override
+  {
+    return capture.close();
+  }
+
+  ErrCode flush() final override
+  {
+    return capture.flush();
+  }
+
+  ErrCode write( const Level level, const void *const message, const size_t length ) final override
+  {
+    std::unique_lock<std::mutex> lock( mMutex );
+    mInWrite = true;
+    mCv.notify_all();
+    mCv.wait_for( lock, TEST_TIMEOUT, [ this ] { return !mStalled; } );
+    mInWrite = false;
+
+    return capture.write( level, message, length );
+  }
+
+  void read( LogReader visitor, const bool direction ) final override
+  {
+    capture.read( visitor, direction );
+  }
+
+  /**
+   * @brief Waits until a drain context is parked inside write()
+   */
+  bool wait_for_stall()
+  {
+    std::unique_lock<std::mutex> lock( mMutex );
+    return mCv.wait_for( lock, TEST_TIMEOUT, [ this ] { return mInWrite; } );
+  }
+
+  /**
+   * @brief Lets every current and future write() complete immediately
+   */
+  void release()
+  {
+    std::lock_guard<std::mutex> lock( mMutex );
+    mStalled = false;
+    mCv.notify_all();
+  }
+
+private:
+  std::mutex              mMutex;
+  std::condition_variable mCv;
+  bool                    mStalled;
+  bool                    mInWrite;
+};
+
+/*-----------------------------------------------------------------------------
+Public Functions
+-----------------------------------------------------------------------------*/
+
+int main( int argc, char **argv )
+{
+  MemoryLeakWarningPlugin::turnOffNewDeleteOverloads();
+  return RUN_ALL_TESTS( argc, argv );
+}
+
+/*-----------------------------------------------------------------------------
+Router Tests
+-----------------------------------------------------------------------------*/
+
+TEST_GROUP( log_router )
+{
+  Router                     *test_router;
+  TestHarness::CaptureSink    fast_sink;
+  TestHarness::CaptureSink    slow_sink;
+  StallingSink                stalled_sink;
+  Router::QueueStorage<4, 64> fast_queue;
+  Router::QueueStorage<4, 64> slow_queue;
+
+  void setup()
+  {
+    mock().clear();
+    mock().ignoreOtherCalls();
+
+    CHECK( fast_sink.open() == ErrCode::ERR_OK );
+    CHECK( slow_sink.open() == ErrCode::ERR_OK );
+
+    test_router = new Router();
+    CHECK( test_router->open() == ErrCode::ERR_OK );
+  }
+
+  void teardown()
+  {
+    mock().checkExpectations();
+
+    test_router->close();
+    delete test_router;
+
+    mock().clear();
+  }
+
+  void write_numbered( const size_t count, const Level level = Level::LVL_INFO )
+  {
+    char message[ 16 ];
+    for( size_t i = 0; i < count; i++ )
+    {
+      const int len = snprintf( message, sizeof( message ), "msg %zu", i );
+      test_router->write( level, message, len );
+    }
+  }
+};
+
+TEST( log_router, add_sink_bad_args )
+{
+  /*---------------------------------------------------------------------------
+  Test Case: No sink
+  ---------------------------------------------------------------------------*/
+  CHECK( test_router->addSink( nullptr, fast_queue, Backpressure::DROP_OLDEST ) == Router::INVALID_SINK );
+
+  /*---------------------------------------------------------------------------
+  Test Case: Same sink registered twice
+  ---------------------------------------------------------------------------*/
+  CHECK( test_router->addSink( &fast_sink, fast_queue, Backpressure::DROP_OLDEST ) != Router::INVALID_SINK );
+  CHECK( test_router->addSink( &fast_sink, slow_queue, Backpressure::DROP_OLDEST ) == Router::INVALID_SINK );
+}
+
+TEST( log_router, write_without_sinks )
+{
+  CHECK( test_router->write( Level::LVL_INFO, "hello", 5 ) == ErrCode::ERR_FAIL );
+}
+
+TEST( log_router, fan_out_is_deferred_until_drain )
+{
+  auto fast_id = test_router->addSink( &fast_sink, fast_queue, Backpressure::DROP_OLDEST );
+  auto slow_id = test_router->addSink( &slow_sink, slow_queue, Backpressure::DROP_OLDEST );
+
+  CHECK( test_router->write( Level::LVL_INFO, "hello", 5 ) == ErrCode::ERR_OK );
+  CHECK( test_router->write( Level::LVL_INFO, "goodbye", 7 ) == ErrCode::ERR_OK );
+
+  /*---------------------------------------------------------------------------
+  Test Case: Nothing reaches a sink until its own drain context runs
+  ---------------------------------------------------------------------------*/
+  CHECK( fast_sink.entries.empty() );
+  CHECK( slow_sink.entries.empty() );
+
+  CHECK_EQUAL( 2, test_router->drain( fast_id ) );
+  CHECK_EQUAL( 2, fast_sink.entries.size() );
+  CHECK( fast_sink.entries[ 0 ].message == "hello" );
+  CHECK( fast_sink.entries[ 1 ].message == "goodbye" );
+  CHECK( slow_sink.entries.empty() );
+
+  CHECK_EQUAL( 2, test_router->drain( slow_id ) );
+  CHECK_EQUAL( 2, slow_sink.entries.size() );
+
+  /*---------------------------------------------------------------------------
+  Test Case: Queues are empty afterwards
+  ---------------------------------------------------------------------------*/
+  CHECK_EQUAL( 0, test_router->drain( fast_id ) );
+  CHECK_EQUAL( 0, test_router->drain( slow_id ) );
+}
+
+TEST( log_router, per_sink_filtering_happens_before_queueing )
+{
+  auto fast_id = test_router->addSink( &fast_sink, fast_queue, Backpressure::DROP_NEWEST );
+  auto slow_id = test_router->addSink( &slow_sink, slow_queue, Backpressure::DROP_NEWEST );
+
+  fast_sink.logLevel = Level::LVL_TRACE;
+  slow_sink.logLevel = Level::LVL_WARN;
+
+  /*---------------------------------------------------------------------------
+  Test Case: Filtered messages never consume the slow sink's queue space
+  ---------------------------------------------------------------------------*/
+  write_numbered( 4, Level::LVL_INFO );
+  CHECK( test_router->write( Level::LVL_ERROR, "fault", 5 ) == ErrCode::ERR_OK );
+
+  test_router->drain( slow_id );
+  CHECK_EQUAL( 1, slow_sink.entries.size() );
+  CHECK( slow_sink.entries[ 0 ].message == "fault" );
+  CHECK_EQUAL( 0, test_router->stats( slow_id ).dropped );
+
+  /*---------------------------------------------------------------------------
+  Test Case: Disabled sinks receive nothing
+  ---------------------------------------------------------------------------*/
+  test_router->drain( fast_id );
+  fast_sink.entries.clear();
+  fast_sink.enabled = false;
+
+  write_numbered( 2 );
+  CHECK_EQUAL( 0, test_router->drain( fast_id ) );
+  CHECK( fast_sink.entries.empty() );
+}
+
+TEST( log_router, drop_oldest_policy )
+{
+  auto id = test_router->addSink( &fast_sink, fast_queue, Backpressure::DROP_OLDEST );
+
+  write_numbered( 6 );
+  test_router->drain( id );
+
+  CHECK_EQUAL( 4, fast_sink.entries.size() );
+  CHECK( fast_sink.entries[ 0 ].message == "msg 2" );
+  CHECK( fast_sink.entries[ 3 ].message == "msg 5" );
+  CHECK_EQUAL( 2, test_router->stats( id ).dropped );
+  CHECK_EQUAL( 4, test_router->stats( id ).delivered );
+}
+
+TEST( log_router, drop_newest_policy )
+{
+  auto id = test_router->addSink( &fast_sink, fast_queue, Backpressure::DROP_NEWEST );
+
+  write_numbered( 6 );
+  test_router->drain( id );
+
+  CHECK_EQUAL( 4, fast_sink.entries.size() );
+  CHECK( fast_sink.entries[ 0 ].message == "msg 0" );
+  CHECK( fast_sink.entries[ 3 ].message == "msg 3" );
+  CHECK_EQUAL( 2, test_router->stats( id ).dropped );
+}
+
+TEST( log_router, oversized_message_is_rejected_per_queue )
+{
+  Router::QueueStorage<4, 8> tiny_queue;
+
+  auto fast_id = test_router->addSink( &fast_sink, fast_queue, Backpressure::DROP_NEWEST );
+  auto slow_id = test_router->addSink( &slow_sink, tiny_queue, Backpressure::DROP_NEWEST );
+
+  CHECK( test_router->write( Level::LVL_INFO, "longer than eight", 17 ) == ErrCode::ERR_OK );
+
+  CHECK_EQUAL( 1, test_router->drain( fast_id ) );
+  CHECK_EQUAL( 0, test_router->drain( slow_id ) );
+  CHECK_EQUAL( 1, test_router->stats( slow_id ).dropped );
+}
+
+TEST( log_router, block_policy_waits_for_space )
+{
+  auto id = test_router->addSink( &fast_sink, fast_queue, Backpressure::BLOCK );
+
+  static constexpr size_t num_messages = 10;
+  std::atomic<bool>       start_drain  = false;
+  std::atomic<bool>       stop         = false;
+
+  /*---------------------------------------------------------------------------
+  Drain context that only begins consuming once told to
+  ---------------------------------------------------------------------------*/
+  std::thread drain_thread( [ & ]() {
+    while( !start_drain && !stop )
+    {
+      std::this_thread::sleep_for( std::chrono::milliseconds( 1 ) );
+    }
+
+    while( !stop )
+    {
+      test_router->drain( id );
+      std::this_thread::sleep_for( std::chrono::milliseconds( 1 ) );
+    }
+    test_router->drain( id );
+  } );
+
+  auto producer = std::async( std::launch::async, [ & ] { write_numbered( num_messages ); } );
+
+  /*---------------------------------------------------------------------------
+  Test Case: With nothing draining, the producer is held once the queue fills
+  ---------------------------------------------------------------------------*/
+  const bool producer_held = ( producer.wait_for( std::chrono::milliseconds( 50 ) ) == std::future_status::timeout );
+
+  /*---------------------------------------------------------------------------
+  Test Case: No messages are lost, the producer simply waits for the queue
+  ---------------------------------------------------------------------------*/
+  start_drain = true;
+
+  const bool producer_finished = ( producer.wait_for( TEST_TIMEOUT ) == std::future_status::ready );
+  const bool all_delivered     = wait_until( [ & ] { return test_router->stats( id ).delivered >= num_messages; } );
+
+  stop = true;
+  drain_thread.join();
+
+  CHECK( producer_held );
+  CHECK( producer_finished );
+  CHECK( all_delivered );
+  CHECK_EQUAL( num_messages, fast_sink.entries.size() );
+  CHECK( fast_sink.entries[ 0 ].message == "msg 0" );
+  CHECK( fast_sink.entries[ num_messages - 1 ].message == "msg 9" );
+  CHECK_EQUAL( 0, test_router->stats( id ).dropped );
+}
+
+TEST( log_router, stalled_sink_does_not_delay_fast_sink )
+{
+  CHECK( stalled_sink.open() == ErrCode::ERR_OK );
+
+  auto fast_id  = test_router->addSink( &fast_sink, fast_queue, Backpressure::DROP_NEWEST );
+  auto stall_id = test_router->addSink( &stalled_sink, slow_queue, Backpressure::DROP_OLDEST );
+
+  static constexpr size_t num_messages = 20;
+  std::atomic<bool>       stop         = false;
+
+  /*---------------------------------------------------------------------------
+  Each sink is drained from its own context, as it would be on target
+  ---------------------------------------------------------------------------*/
+  std::thread fast_thread( [ & ]() {
+    while( !stop )
+    {
+      test_router->drain( fast_id );
+      std::this_thread::sleep_for( std::chrono::microseconds( 100 ) );
+    }
+    test_router->drain( fast_id );
+  } );
+
+  std::thread stall_thread( [ & ]() {
+    while( !stop )
+    {
+      test_router->drain( stall_id );
+      std::this_thread::sleep_for( std::chrono::microseconds( 100 ) );
+    }
+    test_router->drain( stall_id );
+  } );
+
+  /*---------------------------------------------------------------------------
+  Park the stalled sink's drain context inside write(). drain() copies a
+  message out of the queue before handing it over, so the queue keeps its
+  full depth while the sink is busy.
+  ---------------------------------------------------------------------------*/
+  const bool stall_written = ( test_router->write( Level::LVL_INFO, "stall", 5 ) == ErrCode::ERR_OK );
+  const bool stalled       = stalled_sink.wait_for_stall();
+  const bool fast_started  = wait_until( [ & ] { return test_router->stats( fast_id ).delivered >= 1; } );
+
+  /*---------------------------------------------------------------------------
+  Test Case: The fast sink keeps up with every message while the other
+  sink's write() is stuck. Results are only recorded here: a failed CHECK
+  would leave the drain threads joinable.
+  ---------------------------------------------------------------------------*/
+  char message[ 16 ];
+  bool all_written = true;
+  bool kept_up     = true;
+
+  for( size_t i = 0; i < num_messages; i++ )
+  {
+    const int len = snprintf( message, sizeof( message ), "msg %zu", i );
+    all_written   = all_written && ( test_router->write( Level::LVL_INFO, message, len ) == ErrCode::ERR_OK );
+
+    kept_up = kept_up && wait_until( [ & ] { return test_router->stats( fast_id ).delivered >= i + 2; } );
+  }
+
+  const size_t fast_delivered_during_stall = test_router->stats( fast_id ).delivered;
+
+  /*---------------------------------------------------------------------------
+  Release the stall and let its context catch up
+  ---------------------------------------------------------------------------*/
+  stalled_sink.release();
+  const bool stall_caught_up = wait_until( [ & ] { return test_router->stats( stall_id ).delivered >= 5; } );
+
+  stop = true;
+  fast_thread.join();
+  stall_thread.join();
+
+  CHECK( stall_written );
+  CHECK( stalled );
+  CHECK( fast_started );
+  CHECK( all_written );
+  CHECK( kept_up );
+  CHECK_EQUAL( num_messages + 1, fast_delivered_during_stall );
+
+  /*---------------------------------------------------------------------------
+  Test Case: The fast sink got everything, the stalled sink kept the newest
+  ---------------------------------------------------------------------------*/
+  CHECK( stall_caught_up );
+  CHECK_EQUAL( num_messages + 1, fast_sink.entries.size() );
+  CHECK_EQUAL( 0, test_router->stats( fast_id ).dropped );
+
+  CHECK_EQUAL( num_messages - 4, test_router->stats( stall_id ).dropped );
+  CHECK_EQUAL( 5, stalled_sink.capture.entries.size() );
+  CHECK( stalled_sink.capture.entries[ 0 ].message == "stall" );
+  CHECK( stalled_sink.capture.entries[ 1 ].message == "msg 16" );
+  CHECK( stalled_sink.capture.entries[ 4 ].message == "msg 19" );
+}
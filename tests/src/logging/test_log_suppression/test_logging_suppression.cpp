@@ -0,0 +1,267 @@
+/******************************************************************************
+ *  File Name:
+ *    test_logging_suppression.cpp
+ *
+ *  Description:
+ *    Test cases for duplicate suppression and rate limiting of log messages.
+ *
+ *  2024 | Brandon Braun | brandonbraun653@protonmail.com
+ *****************************************************************************/
+
+/*-----------------------------------------------------------------------------
+Includes
+-----------------------------------------------------------------------------*/
+
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <mbedutils/logging.hpp>
+
+#include <CppUTest/TestHarness.h>
+#include <CppUTestExt/MockSupport.h>
+#include <CppUTest/CommandLineTestRunner.h>
+
+#include "CppUMockGen.hpp"
+#include "time_intf_expect.hpp"
+#include <tests/harness/logging_sink_capture.hpp>
+
+using namespace mb::logging;
+using namespace CppUMockGen;
+
+/*-----------------------------------------------------------------------------
+Constants
+-----------------------------------------------------------------------------*/
+
+static constexpr int64_t ONE_SECOND_US    = 1000 * 1000;
+static constexpr int64_t REPEAT_WINDOW_US = ONE_SECOND_US;
+
+/*-----------------------------------------------------------------------------
+Public Functions
+-----------------------------------------------------------------------------*/
+
+int main( int argc, char **argv )
+{
+  return RUN_ALL_TESTS( argc, argv );
+}
+
+/*-----------------------------------------------------------------------------
+SuppressionFilter Tests
+-----------------------------------------------------------------------------*/
+
+TEST_GROUP( log_suppression )
+{
+  SuppressionFilter        *test_filter;
+  SuppressionFilter::Config config;
+  TestHarness::CaptureSink  capture;
+
+  void setup()
+  {
+    mock().clear();
+    mock().ignoreOtherCalls();
+
+    CHECK( capture.open() == ErrCode::ERR_OK );
+
+    test_filter = new SuppressionFilter();
+
+    config.downstream       = &capture;
+    config.repeat_window_us = REPEAT_WINDOW_US;
+  }
+
+  void teardown()
+  {
+    mock().checkExpectations();
+    delete test_filter;
+    mock().clear();
+  }
+
+  void open_default()
+  {
+    test_filter->configure( config );
+    test_filter->enabled  = true;
+    test_filter->logLevel = Level::LVL_TRACE;
+    CHECK( test_filter->open() == ErrCode::ERR_OK );
+  }
+
+  ErrCode write_at( const int64_t time_us, const Level level, const char *message )
+  {
+    expect::mb$::time$::micros( time_us );
+    return test_filter->write( level, message, strlen( message ) );
+  }
+};
+
+TEST( log_suppression, configure_with_invalid_arguments )
+{
+  /*---------------------------------------------------------------------------
+  Test Case: No downstream sink
+  ---------------------------------------------------------------------------*/
+  config.downstream = nullptr;
+  test_filter->configure( config );
+  CHECK( test_filter->open() == ErrCode::ERR_FAIL );
+
+  /*---------------------------------------------------------------------------
+  Test Case: Burst of zero would block a level entirely
+  ---------------------------------------------------------------------------*/
+  config.downstream = &capture;
+  config.setRateLimit( Level::LVL_DEBUG, 10, 0 );
+  test_filter->configure( config );
+  CHECK( test_filter->open() == ErrCode::ERR_FAIL );
+}
+
+TEST( log_suppression, unique_messages_pass_through )
+{
+  open_default();
+
+  CHECK( write_at( 0, Level::LVL_INFO, "one" ) == ErrCode::ERR_OK );
+  CHECK( write_at( 10, Level::LVL_INFO, "two" ) == ErrCode::ERR_OK );
+  CHECK( write_at( 20, Level::LVL_INFO, "three" ) == ErrCode::ERR_OK );
+
+  CHECK_EQUAL( 3, capture.entries.size() );
+  CHECK( capture.entries[ 0 ].message == "one" );
+  CHECK( capture.entries[ 2 ].message == "three" );
+  CHECK_EQUAL( 0, test_filter->stats().duplicates );
+  CHECK_EQUAL( 0, test_filter->stats().rate_limited );
+}
+
+TEST( log_suppression, repeats_collapse_into_summary )
+{
+  open_default();
+
+  /*---------------------------------------------------------------------------
+  A misbehaving loop spams the same line inside the repeat window
+  ---------------------------------------------------------------------------*/
+  for( int64_t i = 0; i < 5; i++ )
+  {
+    write_at( i * 1000, Level::LVL_WARN, "boom" );
+  }
+
+  CHECK_EQUAL( 1, capture.entries.size() );
+  CHECK_EQUAL( 4, test_filter->stats().duplicates );
+
+  /*---------------------------------------------------------------------------
+  Test Case: A different message closes out the run with a summary record
+  ---------------------------------------------------------------------------*/
+  CHECK( write_at( 10000, Level::LVL_INFO, "recovered" ) == ErrCode::ERR_OK );
+
+  CHECK_EQUAL( 3, capture.entries.size() );
+  CHECK( capture.entries[ 0 ].message == "boom" );
+  CHECK( capture.entries[ 1 ].message == "last message repeated 4 times" );
+  CHECK( capture.entries[ 1 ].level == Level::LVL_WARN );
+  CHECK( capture.entries[ 2 ].message == "recovered" );
+  CHECK_EQUAL( 1, test_filter->stats().summaries );
+}
+
+TEST( log_suppression, repeat_after_window_expires_is_forwarded )
+{
+  open_default();
+
+  write_at( 0, Level::LVL_WARN, "boom" );
+  write_at( REPEAT_WINDOW_US / 2, Level::LVL_WARN, "boom" );
+
+  /*---------------------------------------------------------------------------
+  Test Case: Once the window lapses, the summary is emitted and the message
+  is forwarded again so long-running faults stay visible.
+  ---------------------------------------------------------------------------*/
+  write_at( 2 * REPEAT_WINDOW_US, Level::LVL_WARN, "boom" );
+
+  CHECK_EQUAL( 3, capture.entries.size() );
+  CHECK( capture.entries[ 0 ].message == "boom" );
+  CHECK( capture.entries[ 1 ].message == "last message repeated 1 times" );
+  CHECK( capture.entries[ 2 ].message == "boom" );
+}
+
+TEST( log_suppression, same_text_at_different_level_is_not_a_duplicate )
+{
+  open_default();
+
+  write_at( 0, Level::LVL_WARN, "boom" );
+  write_at( 10, Level::LVL_ERROR, "boom" );
+
+  CHECK_EQUAL( 2, capture.entries.size() );
+  CHECK_EQUAL( 0, test_filter->stats().duplicates );
+}
+
+TEST( log_suppression, flush_emits_pending_summary )
+{
+  open_default();
+
+  for( int64_t i = 0; i < 3; i++ )
+  {
+    write_at( i, Level::LVL_ERROR, "boom" );
+  }
+
+  CHECK( test_filter->flush() == ErrCode::ERR_OK );
+
+  CHECK_EQUAL( 2, capture.entries.size() );
+  CHECK( capture.entries[ 1 ].message == "last message repeated 2 times" );
+  CHECK_EQUAL( 1, capture.flush_calls );
+
+  /*---------------------------------------------------------------------------
+  Test Case: A second flush has nothing more to report
+  ---------------------------------------------------------------------------*/
+  CHECK( test_filter->flush() == ErrCode::ERR_OK );
+  CHECK_EQUAL( 2, capture.entries.size() );
+}
+
+TEST( log_suppression, rate_limit_per_level )
+{
+  config.setRateLimit( Level::LVL_DEBUG, 10, 3 );
+  open_default();
+
+  char message[ 16 ];
+
+  /*---------------------------------------------------------------------------
+  Test Case: Only the burst allowance gets through at once
+  ---------------------------------------------------------------------------*/
+  for( size_t i = 0; i < 10; i++ )
+  {
+    snprintf( message, sizeof( message ), "debug %zu", i );
+    write_at( 0, Level::LVL_DEBUG, message );
+  }
+
+  CHECK_EQUAL( 3, capture.entries.size() );
+  CHECK_EQUAL( 7, test_filter->stats().rate_limited );
+  CHECK_EQUAL( 7, test_filter->stats().rate_limited_by_level( Level::LVL_DEBUG ) );
+
+  /*---------------------------------------------------------------------------
+  Test Case: Tokens refill over time, capped at the burst size
+  ---------------------------------------------------------------------------*/
+  for( size_t i = 10; i < 20; i++ )
+  {
+    snprintf( message, sizeof( message ), "debug %zu", i );
+    write_at( ONE_SECOND_US, Level::LVL_DEBUG, message );
+  }
+
+  CHECK_EQUAL( 6, capture.entries.size() );
+  CHECK_EQUAL( 14, test_filter->stats().rate_limited );
+}
+
+TEST( log_suppression, rate_limit_leaves_other_levels_alone )
+{
+  config.setRateLimit( Level::LVL_DEBUG, 1, 1 );
+  open_default();
+
+  char message[ 16 ];
+  for( size_t i = 0; i < 10; i++ )
+  {
+    snprintf( message, sizeof( message ), "error %zu", i );
+    CHECK( write_at( 0, Level::LVL_ERROR, message ) == ErrCode::ERR_OK );
+  }
+
+  CHECK_EQUAL( 10, capture.entries.size() );
+  CHECK_EQUAL( 0, test_filter->stats().rate_limited );
+  CHECK_EQUAL( 0, test_filter->stats().rate_limited_by_level( Level::LVL_ERROR ) );
+}
+
+TEST( log_suppression, reset_stats )
+{
+  open_default();
+
+  write_at( 0, Level::LVL_WARN, "boom" );
+  write_at( 1, Level::LVL_WARN, "boom" );
+  CHECK_EQUAL( 1, test_filter->stats().duplicates );
+
+  test_filter->resetStats();
+  CHECK_EQUAL( 0, test_filter->stats().duplicates );
+  CHECK_EQUAL( 0, test_filter->stats().rate_limited );
+  CHECK_EQUAL( 0, test_filter->stats().summaries );
+}
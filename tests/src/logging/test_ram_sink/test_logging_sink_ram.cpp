@@ -0,0 +1,281 @@
+/******************************************************************************
+ *  File Name:
+ *    test_logging_sink_ram.cpp
+ *
+ *  Description:
+ *    Test cases for the RAM ring-buffer logging sink.
+ *
+ *  2024 | Brandon Braun | brandonbraun653@protonmail.com
+ *****************************************************************************/
+
+/*-----------------------------------------------------------------------------
+Includes
+-----------------------------------------------------------------------------*/
+
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <etl/string.h>
+#include <etl/vector.h>
+#include <mbedutils/logging.hpp>
+
+#include <CppUTest/TestHarness.h>
+#include <CppUTestExt/MockSupport.h>
+#include <CppUTest/CommandLineTestRunner.h>
+
+/*-----------------------------------------------------------------------------
+Static Data
+-----------------------------------------------------------------------------*/
+
+static etl::vector<etl::string<32>, 64> s_read_results;
+
+/*-----------------------------------------------------------------------------
+Static Functions
+-----------------------------------------------------------------------------*/
+
+/**
+ * @brief Generic LogReader that collects every message it is handed
+ */
+static bool cb_read_collect( const void *const message, const size_t length )
+{
+  s_read_results.push_back( etl::string<32>( static_cast<const char *>( message ), length ) );
+  return false; // Keep reading the next log
+}
+
+/**
+ * @brief LogReader that asks the sink to stop after the first message
+ */
+static bool cb_read_first_only( const void *const message, const size_t length )
+{
+  s_read_results.push_back( etl::string<32>( static_cast<const char *>( message ), length ) );
+  return true; // Stop reading
+}
+
+/*-----------------------------------------------------------------------------
+Public Functions
+-----------------------------------------------------------------------------*/
+
+int main( int argc, char **argv )
+{
+  return RUN_ALL_TESTS( argc, argv );
+}
+
+/*-----------------------------------------------------------------------------
+RAMSink Tests
+-----------------------------------------------------------------------------*/
+
+TEST_GROUP( ram_sink )
+{
+  mb::logging::RAMSink        *test_sink;
+  mb::logging::RAMSink::Config config;
+  uint8_t                      backing[ 256 ];
+
+  void setup()
+  {
+    mock().clear();
+    mock().ignoreOtherCalls();
+
+    memset( backing, 0, sizeof( backing ) );
+    s_read_results.clear();
+
+    test_sink = new mb::logging::RAMSink();
+
+    config.buffer = backing;
+    config.size   = sizeof( backing );
+  }
+
+  void teardown()
+  {
+    mock().checkExpectations();
+    delete test_sink;
+    mock().clear();
+  }
+
+  void open_default()
+  {
+    test_sink->configure( config );
+    test_sink->enabled  = true;
+    test_sink->logLevel = mb::logging::Level::LVL_TRACE;
+    CHECK( test_sink->open() == mb::logging::ErrCode::ERR_OK );
+  }
+};
+
+TEST( ram_sink, configure_with_invalid_arguments )
+{
+  /*---------------------------------------------------------------------------
+  Test Case: No backing buffer
+  ---------------------------------------------------------------------------*/
+  config.buffer = nullptr;
+  config.size   = sizeof( backing );
+
+  test_sink->configure( config );
+  CHECK( test_sink->open() == mb::logging::ErrCode::ERR_FAIL );
+
+  /*---------------------------------------------------------------------------
+  Test Case: Zero sized backing buffer
+  ---------------------------------------------------------------------------*/
+  config.buffer = backing;
+  config.size   = 0;
+
+  test_sink->configure( config );
+  CHECK( test_sink->open() == mb::logging::ErrCode::ERR_FAIL );
+}
+
+TEST( ram_sink, open_close_flush )
+{
+  /*---------------------------------------------------------------------------
+  Test Case: Close and flush before configuration are harmless
+  ---------------------------------------------------------------------------*/
+  CHECK( test_sink->close() == mb::logging::ErrCode::ERR_OK );
+  CHECK( test_sink->flush() == mb::logging::ErrCode::ERR_OK );
+
+  /*---------------------------------------------------------------------------
+  Test Case: Nominal open, flush, close
+  ---------------------------------------------------------------------------*/
+  open_default();
+  CHECK( test_sink->flush() == mb::logging::ErrCode::ERR_OK );
+  CHECK( test_sink->close() == mb::logging::ErrCode::ERR_OK );
+
+  /*---------------------------------------------------------------------------
+  Test Case: Writes are rejected once closed
+  ---------------------------------------------------------------------------*/
+  CHECK( test_sink->write( mb::logging::Level::LVL_INFO, "hello", 5 ) == mb::logging::ErrCode::ERR_FAIL );
+}
+
+TEST( ram_sink, insert_bad_args )
+{
+  open_default();
+
+  /*---------------------------------------------------------------------------
+  Test Case: Not enabled
+  ---------------------------------------------------------------------------*/
+  test_sink->enabled = false;
+  CHECK( test_sink->write( mb::logging::Level::LVL_DEBUG, "hello", 5 ) == mb::logging::ErrCode::ERR_FAIL );
+
+  /*---------------------------------------------------------------------------
+  Test Case: Log Level too high
+  ---------------------------------------------------------------------------*/
+  test_sink->enabled  = true;
+  test_sink->logLevel = mb::logging::Level::LVL_INFO;
+  CHECK( test_sink->write( mb::logging::Level::LVL_DEBUG, "hello", 5 ) == mb::logging::ErrCode::ERR_FAIL );
+
+  /*---------------------------------------------------------------------------
+  Test Case: Null message
+  ---------------------------------------------------------------------------*/
+  CHECK( test_sink->write( mb::logging::Level::LVL_INFO, nullptr, 5 ) == mb::logging::ErrCode::ERR_FAIL );
+
+  /*---------------------------------------------------------------------------
+  Test Case: Zero length message
+  ---------------------------------------------------------------------------*/
+  CHECK( test_sink->write( mb::logging::Level::LVL_INFO, "hello", 0 ) == mb::logging::ErrCode::ERR_FAIL );
+
+  /*---------------------------------------------------------------------------
+  Test Case: Message that could never fit in the ring
+  ---------------------------------------------------------------------------*/
+  static uint8_t huge[ sizeof( backing ) + 1 ];
+  CHECK( test_sink->write( mb::logging::Level::LVL_INFO, huge, sizeof( huge ) ) == mb::logging::ErrCode::ERR_FAIL );
+}
+
+TEST( ram_sink, read_back_empty )
+{
+  open_default();
+
+  test_sink->read( mb::logging::LogReader::create<cb_read_collect>(), true );
+  CHECK( s_read_results.empty() );
+
+  test_sink->read( mb::logging::LogReader::create<cb_read_collect>(), false );
+  CHECK( s_read_results.empty() );
+}
+
+TEST( ram_sink, read_back_forward_and_reverse )
+{
+  open_default();
+
+  CHECK( test_sink->write( mb::logging::Level::LVL_INFO, "hello", 5 ) == mb::logging::ErrCode::ERR_OK );
+  CHECK( test_sink->write( mb::logging::Level::LVL_INFO, "variable length", 15 ) == mb::logging::ErrCode::ERR_OK );
+  CHECK( test_sink->write( mb::logging::Level::LVL_INFO, "goodbye", 7 ) == mb::logging::ErrCode::ERR_OK );
+
+  /*---------------------------------------------------------------------------
+  Test Case: Read back all messages forward
+  ---------------------------------------------------------------------------*/
+  test_sink->read( mb::logging::LogReader::create<cb_read_collect>(), true );
+  CHECK_EQUAL( 3, s_read_results.size() );
+  CHECK( s_read_results[ 0 ] == "hello" );
+  CHECK( s_read_results[ 1 ] == "variable length" );
+  CHECK( s_read_results[ 2 ] == "goodbye" );
+
+  /*---------------------------------------------------------------------------
+  Test Case: Read back all messages in reverse
+  ---------------------------------------------------------------------------*/
+  s_read_results.clear();
+  test_sink->read( mb::logging::LogReader::create<cb_read_collect>(), false );
+  CHECK_EQUAL( 3, s_read_results.size() );
+  CHECK( s_read_results[ 0 ] == "goodbye" );
+  CHECK( s_read_results[ 1 ] == "variable length" );
+  CHECK( s_read_results[ 2 ] == "hello" );
+}
+
+TEST( ram_sink, reader_can_stop_early )
+{
+  open_default();
+
+  CHECK( test_sink->write( mb::logging::Level::LVL_INFO, "hello", 5 ) == mb::logging::ErrCode::ERR_OK );
+  CHECK( test_sink->write( mb::logging::Level::LVL_INFO, "goodbye", 7 ) == mb::logging::ErrCode::ERR_OK );
+
+  test_sink->read( mb::logging::LogReader::create<cb_read_first_only>(), false );
+  CHECK_EQUAL( 1, s_read_results.size() );
+  CHECK( s_read_results[ 0 ] == "goodbye" );
+}
+
+TEST( ram_sink, overwrites_oldest_when_full )
+{
+  open_default();
+
+  /*---------------------------------------------------------------------------
+  Write far more data than the ring can hold
+  ---------------------------------------------------------------------------*/
+  static constexpr size_t num_writes = 100;
+  char                    message[ 16 ];
+
+  for( size_t i = 0; i < num_writes; i++ )
+  {
+    const int len = snprintf( message, sizeof( message ), "trace %03zu", i );
+    CHECK( test_sink->write( mb::logging::Level::LVL_TRACE, message, len ) == mb::logging::ErrCode::ERR_OK );
+  }
+
+  /*---------------------------------------------------------------------------
+  Test Case: Only the newest records survive and they are contiguous
+  ---------------------------------------------------------------------------*/
+  test_sink->read( mb::logging::LogReader::create<cb_read_collect>(), true );
+  CHECK( !s_read_results.empty() );
+  CHECK( s_read_results.size() < num_writes );
+  CHECK( s_read_results.back() == "trace 099" );
+
+  const size_t first_idx = num_writes - s_read_results.size();
+  for( size_t i = 0; i < s_read_results.size(); i++ )
+  {
+    snprintf( message, sizeof( message ), "trace %03zu", first_idx + i );
+    CHECK( s_read_results[ i ] == message );
+  }
+
+  /*---------------------------------------------------------------------------
+  Test Case: Reverse iteration sees the same window, newest first
+  ---------------------------------------------------------------------------*/
+  const size_t forward_count = s_read_results.size();
+  s_read_results.clear();
+
+  test_sink->read( mb::logging::LogReader::create<cb_read_collect>(), false );
+  CHECK_EQUAL( forward_count, s_read_results.size() );
+  CHECK( s_read_results.front() == "trace 099" );
+}
+
+TEST( ram_sink, reopen_discards_previous_records )
+{
+  open_default();
+  CHECK( test_sink->write( mb::logging::Level::LVL_INFO, "hello", 5 ) == mb::logging::ErrCode::ERR_OK );
+  CHECK( test_sink->close() == mb::logging::ErrCode::ERR_OK );
+
+  CHECK( test_sink->open() == mb::logging::ErrCode::ERR_OK );
+  test_sink->read( mb::logging::LogReader::create<cb_read_collect>(), true );
+  CHECK( s_read_results.empty() );
+}
@@ -0,0 +1,267 @@
+/******************************************************************************
+ *  File Name:
+ *    test_logging_sink_ram_mt.cpp
+ *
+ *  Description:
+ *    Multi-threaded test cases for the RAM ring-buffer logging sink, covering
+ *    a single producer appending while a reader iterates the ring.
+ *
+ *  2024 | Brandon Braun | brandonbraun653@protonmail.com
+ *****************************************************************************/
+
+/*-----------------------------------------------------------------------------
+Includes
+-----------------------------------------------------------------------------*/
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <etl/string.h>
+#include <future>
+#include <mbedutils/logging.hpp>
+#include <thread>
+
+#include <CppUTest/TestHarness.h>
+#include <CppUTestExt/MockSupport.h>
+#include <CppUTest/CommandLineTestRunner.h>
+
+/*-----------------------------------------------------------------------------
+Constants
+-----------------------------------------------------------------------------*/
+
+static constexpr auto   TEST_TIMEOUT = std::chrono::seconds( 5 );
+static constexpr size_t RECORD_SIZE  = 48;
+static constexpr size_t NUM_RECORDS  = 20000;
+
+/*-----------------------------------------------------------------------------
+Static Data
+-----------------------------------------------------------------------------*/
+
+/**
+ * @brief What a single read pass observed.
+ *
+ * Only the reader thread touches this while a pass is running. CppUTest
+ * checks are not thread safe, so problems are counted here and asserted from
+ * the test thread once the reader has stopped.
+ */
+static struct ReadPass
+{
+  size_t records;
+  size_t torn;
+  size_t out_of_order;
+  long   last_idx;
+
+  void reset()
+  {
+    records      = 0;
+    torn         = 0;
+    out_of_order = 0;
+    last_idx     = -1;
+  }
+} s_pass;
+
+/*-----------------------------------------------------------------------------
+Static Functions
+-----------------------------------------------------------------------------*/
+
+/**
+ * @brief Builds a fixed size record whose body is derived from its prefix.
+ *
+ * Every byte after the prefix repeats the prefix's checksum, so a record that
+ * was torn by a concurrent overwrite is easy to spot.
+ *
+ * @param idx  Sequence number of the record
+ * @return etl::string<RECORD_SIZE>
+ */
+static etl::string<RECORD_SIZE> make_record( const size_t idx )
+{
+  char prefix[ 16 ];
+  snprintf( prefix, sizeof( prefix ), "rec-%06zu ", idx );
+
+  etl::string<RECORD_SIZE> record( prefix );
+
+  uint8_t fill = 0;
+  for( const char c : record )
+  {
+    fill += static_cast<uint8_t>( c );
+  }
+
+  record.resize( RECORD_SIZE, static_cast<char>( 'A' + ( fill % 26 ) ) );
+  return record;
+}
+
+/**
+ * @brief Parses the sequence number of a record and checks it is intact
+ *
+ * @param message  Record bytes handed to the LogReader
+ * @param length   Number of bytes in the record
+ * @return long    Sequence number, or -1 if the record is damaged
+ */
+static long record_index( const void *const message, const size_t length )
+{
+  if( length != RECORD_SIZE )
+  {
+    return -1;
+  }
+
+  const char *text = static_cast<const char *>( message );
+  if( strncmp( text, "rec-", 4 ) != 0 )
+  {
+    return -1;
+  }
+
+  const long idx = strtol( text + 4, nullptr, 10 );
+  if( ( idx < 0 ) || ( static_cast<size_t>( idx ) >= NUM_RECORDS ) )
+  {
+    return -1;
+  }
+
+  const auto expected = make_record( static_cast<size_t>( idx ) );
+  return ( memcmp( message, expected.data(), RECORD_SIZE ) == 0 ) ? idx : -1;
+}
+
+/**
+ * @brief LogReader that validates each record as it is handed over
+ */
+static bool cb_read_validate( const void *const message, const size_t length )
+{
+  const long idx = record_index( message, length );
+
+  s_pass.records++;
+  if( idx < 0 )
+  {
+    s_pass.torn++;
+  }
+  else
+  {
+    if( idx <= s_pass.last_idx )
+    {
+      s_pass.out_of_order++;
+    }
+    s_pass.last_idx = idx;
+  }
+
+  return false; // Keep reading the next log
+}
+
+/*-----------------------------------------------------------------------------
+Public Functions
+-----------------------------------------------------------------------------*/
+
+int main( int argc, char **argv )
+{
+  MemoryLeakWarningPlugin::turnOffNewDeleteOverloads();
+  return RUN_ALL_TESTS( argc, argv );
+}
+
+/*-----------------------------------------------------------------------------
+RAMSink Concurrency Tests
+-----------------------------------------------------------------------------*/
+
+TEST_GROUP( ram_sink_mt )
+{
+  mb::logging::RAMSink        *test_sink;
+  mb::logging::RAMSink::Config config;
+  uint8_t                      backing[ 4096 ];
+
+  void setup()
+  {
+    mock().clear();
+    mock().ignoreOtherCalls();
+
+    memset( backing, 0, sizeof( backing ) );
+    s_pass.reset();
+
+    test_sink = new mb::logging::RAMSink();
+
+    config.buffer = backing;
+    config.size   = sizeof( backing );
+
+    test_sink->configure( config );
+    test_sink->enabled  = true;
+    test_sink->logLevel = mb::logging::Level::LVL_TRACE;
+    CHECK( test_sink->open() == mb::logging::ErrCode::ERR_OK );
+  }
+
+  void teardown()
+  {
+    mock().checkExpectations();
+    delete test_sink;
+    mock().clear();
+  }
+};
+
+
+TEST( ram_sink_mt, reader_never_sees_torn_records )
+{
+  std::atomic<bool>   producer_done = false;
+  std::atomic<size_t> write_errors  = 0;
+  std::atomic<size_t> passes        = 0;
+  std::atomic<size_t> records_read  = 0;
+  std::atomic<size_t> torn          = 0;
+  std::atomic<size_t> out_of_order  = 0;
+
+  /*---------------------------------------------------------------------------
+  Reader: iterate the ring back to back for as long as the producer runs
+  ---------------------------------------------------------------------------*/
+  auto reader = std::async( std::launch::async, [ & ] {
+    do
+    {
+      s_pass.reset();
+      test_sink->read( mb::logging::LogReader::create<cb_read_validate>(), true );
+
+      records_read += s_pass.records;
+      torn += s_pass.torn;
+      out_of_order += s_pass.out_of_order;
+      passes++;
+    } while( !producer_done );
+  } );
+
+  /*---------------------------------------------------------------------------
+  Producer: wrap the ring many times over
+  ---------------------------------------------------------------------------*/
+  auto producer = std::async( std::launch::async, [ & ] {
+    for( size_t i = 0; i < NUM_RECORDS; i++ )
+    {
+      const auto record = make_record( i );
+      if( test_sink->write( mb::logging::Level::LVL_TRACE, record.data(), record.size() ) != mb::logging::ErrCode::ERR_OK )
+      {
+        write_errors++;
+      }
+    }
+
+    producer_done = true;
+  } );
+
+  const bool producer_finished = ( producer.wait_for( TEST_TIMEOUT ) == std::future_status::ready );
+  producer_done                = true;    // Stop the reader even if the producer hung
+  const bool reader_finished   = ( reader.wait_for( TEST_TIMEOUT ) == std::future_status::ready );
+
+  CHECK( producer_finished );
+  CHECK( reader_finished );
+
+  /*---------------------------------------------------------------------------
+  Test Case: Every append succeeds and every record the reader was handed
+  is whole and in sequence, even while it was being overwritten.
+  ---------------------------------------------------------------------------*/
+  CHECK_EQUAL( 0, write_errors.load() );
+  CHECK( passes.load() > 0 );
+  CHECK( records_read.load() > 0 );
+  CHECK_EQUAL( 0, torn.load() );
+  CHECK_EQUAL( 0, out_of_order.load() );
+
+  /*---------------------------------------------------------------------------
+  Test Case: Once quiet, the ring holds a contiguous run ending at the last
+  record written.
+  ---------------------------------------------------------------------------*/
+  s_pass.reset();
+  test_sink->read( mb::logging::LogReader::create<cb_read_validate>(), true );
+
+  CHECK( s_pass.records > 0 );
+  CHECK_EQUAL( 0, s_pass.torn );
+  CHECK_EQUAL( 0, s_pass.out_of_order );
+  CHECK_EQUAL( static_cast<long>( NUM_RECORDS - 1 ), s_pass.last_idx );
+}
@@ -27,8 +27,12 @@ Includes
 #include "time_intf_expect.hpp"
 #include "nor_flash_file.hpp"
 
+#include <tests/harness/nor_flash_timing.hpp>
+
 using namespace mb::db;
 using namespace CppUMockGen;
+using TestHarness::s_flash_0_timed;
+using TestHarness::s_flash_timing;
 
 /*-----------------------------------------------------------------------------
 Static Data
@@ -47,13 +51,13 @@ extern "C"
     .ops      = {
              .init = []( void ) -> int { return 0; },
         .read                        = []( long offset, uint8_t *buf, size_t size ) -> int {
-          return ( mb::memory::Status::ERR_OK == s_flash_0_driver->read( offset, buf, size ) ) ? 0 : -1;
+          return ( mb::memory::Status::ERR_OK == s_flash_0_timed.read( offset, buf, size ) ) ? 0 : -1;
         },
         .write                       = []( long offset, const uint8_t *buf, size_t size ) -> int {
-          return ( mb::memory::Status::ERR_OK == s_flash_0_driver->write( offset, buf, size ) ) ? 0 : -1;
+          return ( mb::memory::Status::ERR_OK == s_flash_0_timed.write( offset, buf, size ) ) ? 0 : -1;
         },
         .erase                       = []( long offset, size_t size ) -> int {
-          return ( mb::memory::Status::ERR_OK == s_flash_0_driver->erase( offset, size ) ) ? 0 : -1;
+          return ( mb::memory::Status::ERR_OK == s_flash_0_timed.erase( offset, size ) ) ? 0 : -1;
         },
     },
     .write_gran                      = 1
@@ -66,6 +70,10 @@ Public Functions
 
 int main( int argc, char **argv )
 {
+  TestHarness::FlashTimingReportPlugin flash_timing;
+  flash_timing.track( &s_flash_0_timed );
+  TestRegistry::getCurrentRegistry()->installPlugin( &flash_timing );
+
   return RUN_ALL_TESTS( argc, argv );
 }
 
@@ -88,9 +96,15 @@ TEST_GROUP( tsdb_sink )
     flash_0_cfg.dev_attr.block_size = fdb_nor_flash0.blk_size;
     flash_0_cfg.dev_attr.size       = fdb_nor_flash0.len;
 
+    if( TestHarness::flash_timing_enabled() )
+    {
+      TestHarness::configure_timed_flash( flash_0_cfg, fdb_nor_flash0.blk_size, fdb_nor_flash0.len );
+    }
+
     expect::mb$::osal$::createRecursiveMutex( IgnoreParameter(), true );
     std::remove( "flash_0_test.bin" );
     s_flash_0_driver->open( "flash_0_test.bin", flash_0_cfg );
+    s_flash_0_timed.attach( s_flash_0_driver, flash_0_cfg, s_flash_timing );
 
     /*-------------------------------------------------------------------------
     Prepare mocks for the test
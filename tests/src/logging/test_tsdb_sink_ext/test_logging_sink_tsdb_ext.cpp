@@ -0,0 +1,1678 @@
+/******************************************************************************
+ *  File Name:
+ *    test_logging_sink_tsdb_ext.cpp
+ *
+ *  Description:
+ *    Test cases for the TimeSeries Database logging sink features that are
+ *    not yet available in the pinned mbedutils revision.
+ *
+ *  2024 | Brandon Braun | brandonbraun653@protonmail.com
+ *****************************************************************************/
+
+/*-----------------------------------------------------------------------------
+Includes
+-----------------------------------------------------------------------------*/
+
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <etl/string.h>
+#include <etl/vector.h>
+#include <mbedutils/database.hpp>
+#include <mbedutils/logging.hpp>
+
+#include <CppUTest/TestHarness.h>
+#include <CppUTestExt/MockSupport.h>
+#include <CppUTest/CommandLineTestRunner.h>
+
+#include "CppUMockGen.hpp"
+#include "CppUTest/UtestMacros.h"
+#include "assert_expect.hpp"
+#include "mutex_intf_expect.hpp"
+#include "time_intf_expect.hpp"
+#include "nor_flash_file.hpp"
+
+#include <tests/harness/nor_flash_timing.hpp>
+
+using namespace mb::db;
+using namespace CppUMockGen;
+using TestHarness::s_flash_0_timed;
+using TestHarness::s_flash_timing;
+
+/*-----------------------------------------------------------------------------
+Static Data
+-----------------------------------------------------------------------------*/
+
+static fake::memory::nor::FileFlash *s_flash_0_driver;
+static int64_t                       s_last_micros         = 0;
+static size_t                        s_flash_bytes_written = 0;
+static size_t                        s_flash_write_calls   = 0;
+
+extern "C"
+{
+  const fal_flash_dev fdb_nor_flash0 = {
+    .name     = "nor_flash_0",
+    .addr     = 0x00000000,
+    .len      = 8 * 1024 * 1024,
+    .blk_size = 4096,
+    .ops      = {
+             .init = []( void ) -> int { return 0; },
+        .read                        = []( long offset, uint8_t *buf, size_t size ) -> int {
+          return ( mb::memory::Status::ERR_OK == s_flash_0_timed.read( offset, buf, size ) ) ? 0 : -1;
+        },
+        .write                       = []( long offset, const uint8_t *buf, size_t size ) -> int {
+          s_flash_bytes_written += size;
+          s_flash_write_calls++;
+          return ( mb::memory::Status::ERR_OK == s_flash_0_timed.write( offset, buf, size ) ) ? 0 : -1;
+        },
+        .erase                       = []( long offset, size_t size ) -> int {
+          return ( mb::memory::Status::ERR_OK == s_flash_0_timed.erase( offset, size ) ) ? 0 : -1;
+        },
+    },
+    .write_gran                      = 1
+  };
+}
+
+/*-----------------------------------------------------------------------------
+Static Functions
+-----------------------------------------------------------------------------*/
+
+/**
+ * @brief Generic LogReader that collects every message it is handed
+ */
+static etl::vector<etl::string<64>, 16> s_read_results;
+static bool cb_read_collect( const void *const message, const size_t length )
+{
+  s_read_results.push_back( etl::string<64>( static_cast<const char *>( message ), length ) );
+  return false; // Keep reading the next log
+}
+
+/*-----------------------------------------------------------------------------
+Fixtures
+-----------------------------------------------------------------------------*/
+
+/**
+ * @brief Backs each group with a fresh flash image behind the timed fal ops
+ *
+ * Groups derive from this and layer their sink configuration on top of the
+ * base setup()/teardown().
+ */
+class TSDBSinkFixture : public Utest
+{
+public:
+  void setup() override
+  {
+    /*-------------------------------------------------------------------------
+    Configure the flash devices
+    -------------------------------------------------------------------------*/
+    expect::mb$::osal$::createRecursiveMutex( IgnoreParameter(), true );
+    open_flash( true );
+    s_flash_bytes_written = 0;
+
+    /*-------------------------------------------------------------------------
+    Prepare mocks for the test
+    -------------------------------------------------------------------------*/
+    mock().clear();
+    mock().ignoreOtherCalls();
+  }
+
+  void teardown() override
+  {
+    /*-------------------------------------------------------------------------
+    Verify test expectations
+    -------------------------------------------------------------------------*/
+    mock().checkExpectations();
+
+    /*-------------------------------------------------------------------------
+    Destroy virtual backing memory
+    -------------------------------------------------------------------------*/
+    close_flash();
+
+    /*-------------------------------------------------------------------------
+    Tear down the test data
+    -------------------------------------------------------------------------*/
+    mock().clear();
+  }
+
+  /**
+   * @brief Opens the flash image and attaches the timing model to it
+   *
+   * @param wipe  Start from a blank image instead of the one left on disk
+   */
+  void open_flash( const bool wipe )
+  {
+    s_flash_0_driver = new fake::memory::nor::FileFlash();
+
+    mb::memory::nor::DeviceConfig flash_0_cfg;
+    TestHarness::configure_timed_flash( flash_0_cfg, fdb_nor_flash0.blk_size, fdb_nor_flash0.len );
+
+    if( wipe )
+    {
+      std::remove( "flash_0_test.bin" );
+    }
+    s_flash_0_driver->open( "flash_0_test.bin", flash_0_cfg );
+    s_flash_0_timed.attach( s_flash_0_driver, flash_0_cfg, s_flash_timing );
+  }
+
+  void close_flash()
+  {
+    s_flash_0_driver->close();
+    delete s_flash_0_driver;
+  }
+};
+
+/*-----------------------------------------------------------------------------
+Public Functions
+-----------------------------------------------------------------------------*/
+
+int main( int argc, char **argv )
+{
+  TestHarness::FlashTimingReportPlugin flash_timing;
+  flash_timing.track( &s_flash_0_timed );
+  TestRegistry::getCurrentRegistry()->installPlugin( &flash_timing );
+
+  return RUN_ALL_TESTS( argc, argv );
+}
+
+/*-----------------------------------------------------------------------------
+TSDBSink Tests
+-----------------------------------------------------------------------------*/
+
+TEST_GROUP_BASE( tsdb_sink, TSDBSinkFixture )
+{
+  mb::logging::TSDBSink* test_sink;
+};
+
+/*-----------------------------------------------------------------------------
+Test Case: Binary (deferred formatting) records
+-----------------------------------------------------------------------------*/
+
+static constexpr mb::logging::FormatId s_fmt_counter = mb::logging::formatId( "counter=%d, mask=0x%x" );
+static constexpr mb::logging::FormatId s_fmt_voltage = mb::logging::formatId( "rail %u at %u mV" );
+
+static const mb::logging::FormatEntry s_fmt_table[] = {
+  { s_fmt_counter, "counter=%d, mask=0x%x" },
+  { s_fmt_voltage, "rail %u at %u mV" },
+};
+
+static size_t s_binary_read_back_count = 0;
+static bool cb_binary_read_back_forward( const void *const message, const size_t length )
+{
+  s_binary_read_back_count++;
+  switch( s_binary_read_back_count )
+  {
+    case 1:
+      CHECK_EQUAL( strlen( "counter=42, mask=0xbeef" ), length );
+      CHECK( memcmp( message, "counter=42, mask=0xbeef", length ) == 0 );
+      break;
+
+    case 2:
+      CHECK_EQUAL( strlen( "rail 3 at 3300 mV" ), length );
+      CHECK( memcmp( message, "rail 3 at 3300 mV", length ) == 0 );
+      break;
+
+    default:
+      FAIL( "Unexpected read count" );
+      break;
+  }
+
+  return false; // Keep reading the next log
+}
+
+TEST( tsdb_sink, binary_format_id_is_compile_time_constant )
+{
+  static_assert( s_fmt_counter != s_fmt_voltage, "Format IDs must be unique" );
+  CHECK( s_fmt_counter == mb::logging::formatId( "counter=%d, mask=0x%x" ) );
+}
+
+TEST( tsdb_sink, binary_insert_bad_args )
+{
+  expect::mb$::osal$::createRecursiveMutex( IgnoreParameter(), true );
+
+  /*---------------------------------------------------------------------------
+  Configure the sink
+  ---------------------------------------------------------------------------*/
+  test_sink = new mb::logging::TSDBSink();
+  CHECK( test_sink != nullptr );
+
+  mb::logging::TSDBSink::Config config;
+  config.dev_name      = "nor_flash_0";
+  config.part_name     = "logging";
+  config.max_log_size  = 256;
+  config.reader_buffer = nullptr;
+  config.fmt_table     = s_fmt_table;
+
+  test_sink->configure( config );
+  CHECK( test_sink->open() == mb::logging::ErrCode::ERR_OK );
+
+  const int32_t args[ 2 ] = { 42, 0xBEEF };
+
+  /*---------------------------------------------------------------------------
+  Test Case: Not enabled
+  ---------------------------------------------------------------------------*/
+  test_sink->enabled = false;
+  CHECK( test_sink->writeBinary( mb::logging::Level::LVL_INFO, s_fmt_counter, args, sizeof( args ) ) == mb::logging::ErrCode::ERR_FAIL );
+
+  /*---------------------------------------------------------------------------
+  Test Case: Log Level too high
+  ---------------------------------------------------------------------------*/
+  test_sink->enabled  = true;
+  test_sink->logLevel = mb::logging::Level::LVL_INFO;
+  CHECK( test_sink->writeBinary( mb::logging::Level::LVL_DEBUG, s_fmt_counter, args, sizeof( args ) ) == mb::logging::ErrCode::ERR_FAIL );
+
+  /*---------------------------------------------------------------------------
+  Test Case: Null arguments with a non-zero size
+  ---------------------------------------------------------------------------*/
+  CHECK( test_sink->writeBinary( mb::logging::Level::LVL_INFO, s_fmt_counter, nullptr, sizeof( args ) ) == mb::logging::ErrCode::ERR_FAIL );
+
+  /*---------------------------------------------------------------------------
+  Test Case: Arguments larger than a single log record
+  ---------------------------------------------------------------------------*/
+  CHECK( test_sink->writeBinary( mb::logging::Level::LVL_INFO, s_fmt_counter, args, config.max_log_size + 1 ) == mb::logging::ErrCode::ERR_FAIL );
+
+  delete test_sink;
+}
+
+TEST( tsdb_sink, binary_read_back_formatted )
+{
+  expect::mb$::osal$::createRecursiveMutex( IgnoreParameter(), true );
+
+  /*---------------------------------------------------------------------------
+  Configure the sink
+  ---------------------------------------------------------------------------*/
+  test_sink = new mb::logging::TSDBSink();
+  CHECK( test_sink != nullptr );
+
+  mb::logging::TSDBSink::Config config;
+  config.dev_name      = "nor_flash_0";
+  config.part_name     = "logging";
+  config.max_log_size  = 256;
+  config.reader_buffer = new uint8_t[ 512 ];
+  config.fmt_table     = s_fmt_table;
+
+  test_sink->configure( config );
+  test_sink->enabled  = true;
+  test_sink->logLevel = mb::logging::Level::LVL_INFO;
+  CHECK( test_sink->open() == mb::logging::ErrCode::ERR_OK );
+
+  /*---------------------------------------------------------------------------
+  Write records in their binary form. Arguments are packed in format order
+  using their native width.
+  ---------------------------------------------------------------------------*/
+  const int32_t  counter_args[ 2 ] = { 42, 0xBEEF };
+  const uint32_t voltage_args[ 2 ] = { 3, 3300 };
+
+  expect::mb$::time$::micros( s_last_micros );
+  s_last_micros += 1000;
+  CHECK( test_sink->writeBinary( mb::logging::Level::LVL_INFO, s_fmt_counter, counter_args, sizeof( counter_args ) ) == mb::logging::ErrCode::ERR_OK );
+
+  expect::mb$::time$::micros( s_last_micros );
+  s_last_micros += 1000;
+  CHECK( test_sink->writeBinary( mb::logging::Level::LVL_INFO, s_fmt_voltage, voltage_args, sizeof( voltage_args ) ) == mb::logging::ErrCode::ERR_OK );
+
+  /*---------------------------------------------------------------------------
+  Test Case: Formatting is deferred until the records are read back
+  ---------------------------------------------------------------------------*/
+  s_binary_read_back_count = 0;
+  auto cb = mb::logging::LogReader::create<cb_binary_read_back_forward>();
+
+  test_sink->read( cb, true );
+  CHECK( s_binary_read_back_count == 2 );
+
+  delete[] config.reader_buffer;
+  delete test_sink;
+}
+
+TEST( tsdb_sink, binary_record_uses_less_flash_than_text )
+{
+  expect::mb$::osal$::createRecursiveMutex( IgnoreParameter(), true );
+
+  /*---------------------------------------------------------------------------
+  Configure the sink
+  ---------------------------------------------------------------------------*/
+  test_sink = new mb::logging::TSDBSink();
+  CHECK( test_sink != nullptr );
+
+  mb::logging::TSDBSink::Config config;
+  config.dev_name      = "nor_flash_0";
+  config.part_name     = "logging";
+  config.max_log_size  = 256;
+  config.reader_buffer = nullptr;
+  config.fmt_table     = s_fmt_table;
+
+  test_sink->configure( config );
+  test_sink->enabled  = true;
+  test_sink->logLevel = mb::logging::Level::LVL_INFO;
+  CHECK( test_sink->open() == mb::logging::ErrCode::ERR_OK );
+
+  /*---------------------------------------------------------------------------
+  The first append into an empty sector also writes the sector header. Take
+  that hit with a throw-away record so both measurements are steady-state.
+  ---------------------------------------------------------------------------*/
+  const char *text = "counter=42, mask=0xbeef";
+
+  expect::mb$::time$::micros( s_last_micros );
+  s_last_micros += 1000;
+  CHECK( test_sink->write( mb::logging::Level::LVL_INFO, text, strlen( text ) ) == mb::logging::ErrCode::ERR_OK );
+
+  /*---------------------------------------------------------------------------
+  Measure the flash cost of the formatted text record
+  ---------------------------------------------------------------------------*/
+  expect::mb$::time$::micros( s_last_micros );
+  s_last_micros += 1000;
+  size_t start_bytes = s_flash_bytes_written;
+  CHECK( test_sink->write( mb::logging::Level::LVL_INFO, text, strlen( text ) ) == mb::logging::ErrCode::ERR_OK );
+  const size_t text_bytes = s_flash_bytes_written - start_bytes;
+
+  /*---------------------------------------------------------------------------
+  Measure the flash cost of the equivalent binary record
+  ---------------------------------------------------------------------------*/
+  const int32_t args[ 2 ] = { 42, 0xBEEF };
+
+  expect::mb$::time$::micros( s_last_micros );
+  s_last_micros += 1000;
+  start_bytes = s_flash_bytes_written;
+  CHECK( test_sink->writeBinary( mb::logging::Level::LVL_INFO, s_fmt_counter, args, sizeof( args ) ) == mb::logging::ErrCode::ERR_OK );
+  const size_t binary_bytes = s_flash_bytes_written - start_bytes;
+
+  /*---------------------------------------------------------------------------
+  Test Case: Record framing is identical, so the saving is exactly the text
+  payload traded for a format ID and the packed arguments.
+  ---------------------------------------------------------------------------*/
+  const size_t binary_payload = sizeof( mb::logging::FormatId ) + sizeof( args );
+
+  CHECK( binary_bytes < text_bytes );
+  CHECK_EQUAL( strlen( text ) - binary_payload, text_bytes - binary_bytes );
+
+  delete test_sink;
+}
+
+/*-----------------------------------------------------------------------------
+Test Case: Filtered queries
+-----------------------------------------------------------------------------*/
+
+TEST_GROUP_BASE( tsdb_sink_query, TSDBSinkFixture )
+{
+  mb::logging::TSDBSink        *test_sink;
+  mb::logging::TSDBSink::Config config;
+  int64_t                       record_time[ 4 ];
+
+  void setup() override
+  {
+    TSDBSinkFixture::setup();
+
+    /*-------------------------------------------------------------------------
+    Configure the sink
+    -------------------------------------------------------------------------*/
+    expect::mb$::osal$::createRecursiveMutex( IgnoreParameter(), true );
+
+    test_sink = new mb::logging::TSDBSink();
+
+    config.dev_name      = "nor_flash_0";
+    config.part_name     = "logging";
+    config.max_log_size  = 256;
+    config.reader_buffer = new uint8_t[ 512 ];
+
+    test_sink->configure( config );
+    test_sink->enabled  = true;
+    test_sink->logLevel = mb::logging::Level::LVL_INFO;
+    CHECK( test_sink->open() == mb::logging::ErrCode::ERR_OK );
+
+    /*-------------------------------------------------------------------------
+    Populate the partition with a known set of timestamped records
+    -------------------------------------------------------------------------*/
+    write_at( 0, mb::logging::Level::LVL_INFO, "boot" );
+    write_at( 1, mb::logging::Level::LVL_WARN, "low battery" );
+    write_at( 2, mb::logging::Level::LVL_ERROR, "sensor fault" );
+    write_at( 3, mb::logging::Level::LVL_WARN, "retrying" );
+
+    s_read_results.clear();
+  }
+
+  void teardown() override
+  {
+    delete[] config.reader_buffer;
+    delete test_sink;
+
+    TSDBSinkFixture::teardown();
+  }
+
+  void write_at( const size_t idx, const mb::logging::Level level, const char *message )
+  {
+    record_time[ idx ] = s_last_micros;
+    expect::mb$::time$::micros( s_last_micros );
+    s_last_micros += 1000;
+
+    CHECK( test_sink->write( level, message, strlen( message ) ) == mb::logging::ErrCode::ERR_OK );
+  }
+};
+
+TEST( tsdb_sink_query, bad_arguments )
+{
+  mb::logging::TSDBSink::Query query;
+  auto                         cb = mb::logging::LogReader::create<cb_read_collect>();
+
+  /*---------------------------------------------------------------------------
+  Test Case: Inverted time range
+  ---------------------------------------------------------------------------*/
+  query.start_time = record_time[ 2 ];
+  query.end_time   = record_time[ 1 ];
+  CHECK( test_sink->read( cb, query ) == mb::logging::ErrCode::ERR_FAIL );
+  CHECK( s_read_results.empty() );
+
+  /*---------------------------------------------------------------------------
+  Test Case: Invalid reader
+  ---------------------------------------------------------------------------*/
+  query = {};
+  CHECK( test_sink->read( mb::logging::LogReader(), query ) == mb::logging::ErrCode::ERR_FAIL );
+
+  /*---------------------------------------------------------------------------
+  Test Case: Sink is closed
+  ---------------------------------------------------------------------------*/
+  CHECK( test_sink->close() == mb::logging::ErrCode::ERR_OK );
+  CHECK( test_sink->read( cb, query ) == mb::logging::ErrCode::ERR_FAIL );
+  CHECK( s_read_results.empty() );
+}
+
+TEST( tsdb_sink_query, default_query_returns_everything )
+{
+  mb::logging::TSDBSink::Query query;
+
+  CHECK( test_sink->read( mb::logging::LogReader::create<cb_read_collect>(), query ) == mb::logging::ErrCode::ERR_OK );
+  CHECK_EQUAL( 4, s_read_results.size() );
+  CHECK( s_read_results[ 0 ] == "boot" );
+  CHECK( s_read_results[ 3 ] == "retrying" );
+}
+
+TEST( tsdb_sink_query, time_range )
+{
+  mb::logging::TSDBSink::Query query;
+  query.start_time = record_time[ 1 ];
+  query.end_time   = record_time[ 2 ];
+
+  CHECK( test_sink->read( mb::logging::LogReader::create<cb_read_collect>(), query ) == mb::logging::ErrCode::ERR_OK );
+  CHECK_EQUAL( 2, s_read_results.size() );
+  CHECK( s_read_results[ 0 ] == "low battery" );
+  CHECK( s_read_results[ 1 ] == "sensor fault" );
+}
+
+TEST( tsdb_sink_query, minimum_level )
+{
+  mb::logging::TSDBSink::Query query;
+  query.min_level = mb::logging::Level::LVL_WARN;
+
+  CHECK( test_sink->read( mb::logging::LogReader::create<cb_read_collect>(), query ) == mb::logging::ErrCode::ERR_OK );
+  CHECK_EQUAL( 3, s_read_results.size() );
+  CHECK( s_read_results[ 0 ] == "low battery" );
+  CHECK( s_read_results[ 1 ] == "sensor fault" );
+  CHECK( s_read_results[ 2 ] == "retrying" );
+}
+
+TEST( tsdb_sink_query, max_count_in_reverse )
+{
+  mb::logging::TSDBSink::Query query;
+  query.forward   = false;
+  query.max_count = 2;
+
+  CHECK( test_sink->read( mb::logging::LogReader::create<cb_read_collect>(), query ) == mb::logging::ErrCode::ERR_OK );
+  CHECK_EQUAL( 2, s_read_results.size() );
+  CHECK( s_read_results[ 0 ] == "retrying" );
+  CHECK( s_read_results[ 1 ] == "sensor fault" );
+}
+
+TEST( tsdb_sink_query, recent_warnings )
+{
+  /*---------------------------------------------------------------------------
+  Test Case: "Most recent warnings", newest first, bounded in time and count
+  ---------------------------------------------------------------------------*/
+  mb::logging::TSDBSink::Query query;
+  query.start_time = record_time[ 1 ];
+  query.min_level  = mb::logging::Level::LVL_WARN;
+  query.max_count  = 3;
+  query.forward    = false;
+
+  CHECK( test_sink->read( mb::logging::LogReader::create<cb_read_collect>(), query ) == mb::logging::ErrCode::ERR_OK );
+  CHECK_EQUAL( 3, s_read_results.size() );
+  CHECK( s_read_results[ 0 ] == "retrying" );
+  CHECK( s_read_results[ 1 ] == "sensor fault" );
+  CHECK( s_read_results[ 2 ] == "low battery" );
+}
+
+TEST( tsdb_sink_query, empty_range )
+{
+  mb::logging::TSDBSink::Query query;
+  query.start_time = s_last_micros + 1000;
+
+  CHECK( test_sink->read( mb::logging::LogReader::create<cb_read_collect>(), query ) == mb::logging::ErrCode::ERR_OK );
+  CHECK( s_read_results.empty() );
+}
+
+static size_t s_query_read_count = 0;
+static bool cb_query_count( const void *const message, const size_t length )
+{
+  ( void )message;
+  ( void )length;
+
+  s_query_read_count++;
+  return false; // Keep reading the next log
+}
+
+TEST( tsdb_sink_query, time_range_reads_less_flash_than_full_scan )
+{
+  /*---------------------------------------------------------------------------
+  Spread enough records over the partition to fill several sectors
+  ---------------------------------------------------------------------------*/
+  const char *filler = "periodic telemetry: vbat=3712mV temp=24C rssi=-67dBm q=0";
+
+  for( size_t i = 0; i < 256; i++ )
+  {
+    expect::mb$::time$::micros( s_last_micros );
+    s_last_micros += 1000;
+    CHECK( test_sink->write( mb::logging::Level::LVL_INFO, filler, strlen( filler ) ) == mb::logging::ErrCode::ERR_OK );
+  }
+
+  const int64_t window_start = s_last_micros - 4000;
+
+  /*---------------------------------------------------------------------------
+  Measure a full scan
+  ---------------------------------------------------------------------------*/
+  mb::logging::TSDBSink::Query query;
+  auto                         cb = mb::logging::LogReader::create<cb_query_count>();
+
+  s_query_read_count = 0;
+  auto start         = s_flash_0_timed.stats();
+  CHECK( test_sink->read( cb, query ) == mb::logging::ErrCode::ERR_OK );
+  const size_t   full_reads  = s_flash_0_timed.stats().reads - start.reads;
+  const uint64_t full_bus_us = s_flash_0_timed.stats().bus_us - start.bus_us;
+  CHECK_EQUAL( 260, s_query_read_count );
+
+  /*---------------------------------------------------------------------------
+  Test Case: A query over the newest records skips the older sectors
+  ---------------------------------------------------------------------------*/
+  query.start_time = window_start;
+
+  s_query_read_count = 0;
+  start              = s_flash_0_timed.stats();
+  CHECK( test_sink->read( cb, query ) == mb::logging::ErrCode::ERR_OK );
+  const size_t   window_reads  = s_flash_0_timed.stats().reads - start.reads;
+  const uint64_t window_bus_us = s_flash_0_timed.stats().bus_us - start.bus_us;
+  CHECK_EQUAL( 4, s_query_read_count );
+
+  CHECK( window_reads < full_reads );
+  CHECK( window_bus_us < full_bus_us );
+}
+
+/*-----------------------------------------------------------------------------
+Test Case: Batched records
+-----------------------------------------------------------------------------*/
+
+/**
+ * @brief Checks that one batched entry kept its own level and timestamp.
+ *
+ * Entries store their timestamp as a delta from the batch start, so an exact
+ * single-instant query only matches if the delta is rebuilt correctly. The
+ * level must pass a filter at its own level and fail one level above it.
+ */
+static void check_batch_entry( mb::logging::TSDBSink *const sink, const char *message, const int64_t timestamp,
+                               const mb::logging::Level level, const mb::logging::Level above )
+{
+  mb::logging::TSDBSink::Query query;
+  query.start_time = timestamp;
+  query.end_time   = timestamp;
+  query.min_level  = level;
+
+  s_read_results.clear();
+  CHECK( sink->read( mb::logging::LogReader::create<cb_read_collect>(), query ) == mb::logging::ErrCode::ERR_OK );
+  CHECK_EQUAL( 1, s_read_results.size() );
+  CHECK( s_read_results[ 0 ] == message );
+
+  query.min_level = above;
+
+  s_read_results.clear();
+  CHECK( sink->read( mb::logging::LogReader::create<cb_read_collect>(), query ) == mb::logging::ErrCode::ERR_OK );
+  CHECK( s_read_results.empty() );
+}
+
+TEST( tsdb_sink, batch_read_back )
+{
+  expect::mb$::osal$::createRecursiveMutex( IgnoreParameter(), true );
+
+  /*---------------------------------------------------------------------------
+  Configure the sink
+  ---------------------------------------------------------------------------*/
+  test_sink = new mb::logging::TSDBSink();
+  CHECK( test_sink != nullptr );
+
+  mb::logging::TSDBSink::Config config;
+  config.dev_name      = "nor_flash_0";
+  config.part_name     = "logging";
+  config.max_log_size  = 256;
+  config.reader_buffer = new uint8_t[ 512 ];
+  config.batch_buffer  = new uint8_t[ 256 ];
+
+  test_sink->configure( config );
+  test_sink->enabled  = true;
+  test_sink->logLevel = mb::logging::Level::LVL_DEBUG;
+  CHECK( test_sink->open() == mb::logging::ErrCode::ERR_OK );
+
+  /*---------------------------------------------------------------------------
+  Test Case: Messages are held in RAM until the batch is committed
+  ---------------------------------------------------------------------------*/
+  const size_t             start_bytes = s_flash_bytes_written;
+  const char              *messages[]  = { "hello", "batched", "world" };
+  const mb::logging::Level levels[]    = { mb::logging::Level::LVL_DEBUG, mb::logging::Level::LVL_INFO,
+                                           mb::logging::Level::LVL_WARN };
+  const mb::logging::Level above[]     = { mb::logging::Level::LVL_INFO, mb::logging::Level::LVL_WARN,
+                                           mb::logging::Level::LVL_ERROR };
+  const int64_t            gaps[]      = { 1000, 250, 7000 };
+  int64_t                  times[ 3 ];
+
+  for( size_t i = 0; i < 3; i++ )
+  {
+    times[ i ] = s_last_micros;
+    expect::mb$::time$::micros( s_last_micros );
+    s_last_micros += gaps[ i ];
+    CHECK( test_sink->write( levels[ i ], messages[ i ], strlen( messages[ i ] ) ) == mb::logging::ErrCode::ERR_OK );
+  }
+
+  CHECK_EQUAL( start_bytes, s_flash_bytes_written );
+  CHECK( test_sink->flush() == mb::logging::ErrCode::ERR_OK );
+  CHECK( s_flash_bytes_written > start_bytes );
+
+  /*---------------------------------------------------------------------------
+  Test Case: Reader sees each message individually, in both directions
+  ---------------------------------------------------------------------------*/
+  s_read_results.clear();
+  test_sink->read( mb::logging::LogReader::create<cb_read_collect>(), true );
+  CHECK_EQUAL( 3, s_read_results.size() );
+  CHECK( s_read_results[ 0 ] == "hello" );
+  CHECK( s_read_results[ 1 ] == "batched" );
+  CHECK( s_read_results[ 2 ] == "world" );
+
+  s_read_results.clear();
+  test_sink->read( mb::logging::LogReader::create<cb_read_collect>(), false );
+  CHECK_EQUAL( 3, s_read_results.size() );
+  CHECK( s_read_results[ 0 ] == "world" );
+  CHECK( s_read_results[ 1 ] == "batched" );
+  CHECK( s_read_results[ 2 ] == "hello" );
+
+  /*---------------------------------------------------------------------------
+  Test Case: Each entry keeps its own level and timestamp
+  ---------------------------------------------------------------------------*/
+  for( size_t i = 0; i < 3; i++ )
+  {
+    check_batch_entry( test_sink, messages[ i ], times[ i ], levels[ i ], above[ i ] );
+  }
+
+  delete[] config.batch_buffer;
+  delete[] config.reader_buffer;
+  delete test_sink;
+}
+
+TEST( tsdb_sink, batch_read_includes_pending_messages )
+{
+  expect::mb$::osal$::createRecursiveMutex( IgnoreParameter(), true );
+
+  /*---------------------------------------------------------------------------
+  Configure the sink
+  ---------------------------------------------------------------------------*/
+  test_sink = new mb::logging::TSDBSink();
+  CHECK( test_sink != nullptr );
+
+  mb::logging::TSDBSink::Config config;
+  config.dev_name      = "nor_flash_0";
+  config.part_name     = "logging";
+  config.max_log_size  = 256;
+  config.reader_buffer = new uint8_t[ 512 ];
+  config.batch_buffer  = new uint8_t[ 256 ];
+
+  test_sink->configure( config );
+  test_sink->enabled  = true;
+  test_sink->logLevel = mb::logging::Level::LVL_INFO;
+  CHECK( test_sink->open() == mb::logging::ErrCode::ERR_OK );
+
+  const int64_t hello_time = s_last_micros;
+  expect::mb$::time$::micros( s_last_micros );
+  s_last_micros += 1000;
+  CHECK( test_sink->write( mb::logging::Level::LVL_INFO, "hello", 5 ) == mb::logging::ErrCode::ERR_OK );
+
+  const int64_t goodbye_time = s_last_micros;
+  expect::mb$::time$::micros( s_last_micros );
+  s_last_micros += 1000;
+  CHECK( test_sink->write( mb::logging::Level::LVL_WARN, "goodbye", 7 ) == mb::logging::ErrCode::ERR_OK );
+
+  /*---------------------------------------------------------------------------
+  Test Case: Reading without an explicit flush still returns everything
+  ---------------------------------------------------------------------------*/
+  s_read_results.clear();
+  test_sink->read( mb::logging::LogReader::create<cb_read_collect>(), true );
+  CHECK_EQUAL( 2, s_read_results.size() );
+  CHECK( s_read_results[ 0 ] == "hello" );
+  CHECK( s_read_results[ 1 ] == "goodbye" );
+
+  /*---------------------------------------------------------------------------
+  Test Case: Pending entries keep their own level and timestamp
+  ---------------------------------------------------------------------------*/
+  check_batch_entry( test_sink, "hello", hello_time, mb::logging::Level::LVL_INFO, mb::logging::Level::LVL_WARN );
+  check_batch_entry( test_sink, "goodbye", goodbye_time, mb::logging::Level::LVL_WARN, mb::logging::Level::LVL_ERROR );
+
+  delete[] config.batch_buffer;
+  delete[] config.reader_buffer;
+  delete test_sink;
+}
+
+TEST( tsdb_sink, batch_commits_when_full )
+{
+  expect::mb$::osal$::createRecursiveMutex( IgnoreParameter(), true );
+
+  /*---------------------------------------------------------------------------
+  Configure the sink with a batch that only fits a few messages
+  ---------------------------------------------------------------------------*/
+  test_sink = new mb::logging::TSDBSink();
+  CHECK( test_sink != nullptr );
+
+  mb::logging::TSDBSink::Config config;
+  config.dev_name      = "nor_flash_0";
+  config.part_name     = "logging";
+  config.max_log_size  = 64;
+  config.reader_buffer = new uint8_t[ 128 ];
+  config.batch_buffer  = new uint8_t[ 64 ];
+
+  test_sink->configure( config );
+  test_sink->enabled  = true;
+  test_sink->logLevel = mb::logging::Level::LVL_INFO;
+  CHECK( test_sink->open() == mb::logging::ErrCode::ERR_OK );
+
+  /*---------------------------------------------------------------------------
+  Test Case: Overflowing the batch commits it without a flush
+  ---------------------------------------------------------------------------*/
+  const size_t             start_bytes = s_flash_bytes_written;
+  const char              *message     = "twenty byte message!";
+  const mb::logging::Level levels[]    = { mb::logging::Level::LVL_INFO, mb::logging::Level::LVL_WARN,
+                                           mb::logging::Level::LVL_INFO, mb::logging::Level::LVL_WARN };
+  const mb::logging::Level above[]     = { mb::logging::Level::LVL_WARN, mb::logging::Level::LVL_ERROR,
+                                           mb::logging::Level::LVL_WARN, mb::logging::Level::LVL_ERROR };
+  int64_t                  times[ 4 ];
+
+  for( size_t i = 0; i < 4; i++ )
+  {
+    times[ i ] = s_last_micros;
+    expect::mb$::time$::micros( s_last_micros );
+    s_last_micros += 1000 + ( i * 300 );
+    CHECK( test_sink->write( levels[ i ], message, strlen( message ) ) == mb::logging::ErrCode::ERR_OK );
+  }
+
+  CHECK( s_flash_bytes_written > start_bytes );
+
+  s_read_results.clear();
+  test_sink->read( mb::logging::LogReader::create<cb_read_collect>(), true );
+  CHECK_EQUAL( 4, s_read_results.size() );
+
+  /*---------------------------------------------------------------------------
+  Test Case: Levels and timestamps survive the commit, including entries that
+  start a new batch and so a new delta base.
+  ---------------------------------------------------------------------------*/
+  for( size_t i = 0; i < 4; i++ )
+  {
+    check_batch_entry( test_sink, message, times[ i ], levels[ i ], above[ i ] );
+  }
+
+  delete[] config.batch_buffer;
+  delete[] config.reader_buffer;
+  delete test_sink;
+}
+
+TEST( tsdb_sink, batch_reduces_flash_usage )
+{
+  static constexpr size_t num_messages = 10;
+  static constexpr size_t payload_size = 5;
+
+  mb::logging::TSDBSink::Config config;
+  config.dev_name      = "nor_flash_0";
+  config.part_name     = "logging";
+  config.max_log_size  = 256;
+  config.reader_buffer = nullptr;
+
+  /*---------------------------------------------------------------------------
+  Measure the flash cost of the unbatched messages. The last write lands in
+  an already active sector, so it gives the steady state cost of one record.
+  ---------------------------------------------------------------------------*/
+  expect::mb$::osal$::createRecursiveMutex( IgnoreParameter(), true );
+  test_sink = new mb::logging::TSDBSink();
+  test_sink->configure( config );
+  test_sink->enabled  = true;
+  test_sink->logLevel = mb::logging::Level::LVL_INFO;
+  CHECK( test_sink->open() == mb::logging::ErrCode::ERR_OK );
+
+  size_t start_bytes  = s_flash_bytes_written;
+  size_t record_bytes = 0;
+  for( size_t i = 0; i < num_messages; i++ )
+  {
+    const size_t before = s_flash_bytes_written;
+
+    expect::mb$::time$::micros( s_last_micros );
+    s_last_micros += 1000;
+    CHECK( test_sink->write( mb::logging::Level::LVL_INFO, "hello", payload_size ) == mb::logging::ErrCode::ERR_OK );
+    record_bytes = s_flash_bytes_written - before;
+  }
+  CHECK( test_sink->flush() == mb::logging::ErrCode::ERR_OK );
+  const size_t unbatched_bytes = s_flash_bytes_written - start_bytes;
+  delete test_sink;
+
+  /*---------------------------------------------------------------------------
+  Measure the flash cost of the same messages batched together
+  ---------------------------------------------------------------------------*/
+  config.batch_buffer = new uint8_t[ 256 ];
+
+  expect::mb$::osal$::createRecursiveMutex( IgnoreParameter(), true );
+  test_sink = new mb::logging::TSDBSink();
+  test_sink->configure( config );
+  test_sink->enabled  = true;
+  test_sink->logLevel = mb::logging::Level::LVL_INFO;
+  CHECK( test_sink->open() == mb::logging::ErrCode::ERR_OK );
+
+  start_bytes = s_flash_bytes_written;
+  for( size_t i = 0; i < num_messages; i++ )
+  {
+    expect::mb$::time$::micros( s_last_micros );
+    s_last_micros += 1000;
+    CHECK( test_sink->write( mb::logging::Level::LVL_INFO, "hello", payload_size ) == mb::logging::ErrCode::ERR_OK );
+  }
+  CHECK( test_sink->flush() == mb::logging::ErrCode::ERR_OK );
+  const size_t batched_bytes = s_flash_bytes_written - start_bytes;
+
+  /*---------------------------------------------------------------------------
+  Test Case: All but one TSDB record overhead is saved, less the small header
+  each batched entry carries in place of it.
+  ---------------------------------------------------------------------------*/
+  CHECK( record_bytes > payload_size );
+
+  const size_t record_overhead = record_bytes - payload_size;
+  const size_t entry_overhead  = sizeof( mb::logging::BatchEntryHeader );
+  const size_t expected_saving = ( num_messages - 1 ) * record_overhead - num_messages * entry_overhead;
+
+  CHECK( batched_bytes < unbatched_bytes );
+  CHECK( ( unbatched_bytes - batched_bytes ) >= expected_saving );
+
+  delete[] config.batch_buffer;
+  delete test_sink;
+}
+
+/*-----------------------------------------------------------------------------
+Test Case: Compressed blocks
+-----------------------------------------------------------------------------*/
+
+/**
+ * @brief Writes a repetitive, but not identical, stream of log lines
+ *
+ * @param sink      Sink to write into
+ * @param count     Number of messages to write
+ * @return size_t   Total number of message bytes handed to the sink
+ */
+static size_t write_repetitive_logs( mb::logging::TSDBSink *sink, const size_t count )
+{
+  char   message[ 64 ];
+  size_t total = 0;
+
+  for( size_t i = 0; i < count; i++ )
+  {
+    const int len = snprintf( message, sizeof( message ), "[sensor] channel %zu sample %zu status=OK", i % 4, i );
+
+    expect::mb$::time$::micros( s_last_micros );
+    s_last_micros += 1000;
+    CHECK( sink->write( mb::logging::Level::LVL_INFO, message, len ) == mb::logging::ErrCode::ERR_OK );
+    total += len;
+  }
+
+  return total;
+}
+
+TEST( tsdb_sink, compression_requires_block_buffer )
+{
+  expect::mb$::osal$::createRecursiveMutex( IgnoreParameter(), true );
+
+  test_sink = new mb::logging::TSDBSink();
+  CHECK( test_sink != nullptr );
+
+  /*---------------------------------------------------------------------------
+  Test Case: Compression is block based and needs the batch buffer
+  ---------------------------------------------------------------------------*/
+  mb::logging::TSDBSink::Config config;
+  config.dev_name      = "nor_flash_0";
+  config.part_name     = "logging";
+  config.max_log_size  = 256;
+  config.reader_buffer = nullptr;
+  config.batch_buffer  = nullptr;
+  config.compress      = true;
+
+  test_sink->configure( config );
+  CHECK( test_sink->open() == mb::logging::ErrCode::ERR_FAIL );
+
+  delete test_sink;
+}
+
+TEST( tsdb_sink, compressed_read_back )
+{
+  expect::mb$::osal$::createRecursiveMutex( IgnoreParameter(), true );
+
+  /*---------------------------------------------------------------------------
+  Configure the sink
+  ---------------------------------------------------------------------------*/
+  test_sink = new mb::logging::TSDBSink();
+  CHECK( test_sink != nullptr );
+
+  mb::logging::TSDBSink::Config config;
+  config.dev_name      = "nor_flash_0";
+  config.part_name     = "logging";
+  config.max_log_size  = 512;
+  config.reader_buffer = new uint8_t[ 1024 ];
+  config.batch_buffer  = new uint8_t[ 512 ];
+  config.compress      = true;
+
+  test_sink->configure( config );
+  test_sink->enabled  = true;
+  test_sink->logLevel = mb::logging::Level::LVL_INFO;
+  CHECK( test_sink->open() == mb::logging::ErrCode::ERR_OK );
+
+  write_repetitive_logs( test_sink, s_read_results.capacity() );
+  CHECK( test_sink->flush() == mb::logging::ErrCode::ERR_OK );
+
+  /*---------------------------------------------------------------------------
+  Test Case: Every message survives the compress/decompress round trip
+  ---------------------------------------------------------------------------*/
+  s_read_results.clear();
+  test_sink->read( mb::logging::LogReader::create<cb_read_collect>(), true );
+  CHECK_EQUAL( s_read_results.capacity(), s_read_results.size() );
+
+  char expected[ 64 ];
+  for( size_t i = 0; i < s_read_results.size(); i++ )
+  {
+    snprintf( expected, sizeof( expected ), "[sensor] channel %zu sample %zu status=OK", i % 4, i );
+    CHECK( s_read_results[ i ] == expected );
+  }
+
+  delete[] config.batch_buffer;
+  delete[] config.reader_buffer;
+  delete test_sink;
+}
+
+/*-----------------------------------------------------------------------------
+Test Case: Chunked export
+-----------------------------------------------------------------------------*/
+
+TEST_GROUP_BASE( tsdb_sink_export, TSDBSinkFixture )
+{
+  mb::logging::TSDBSink        *test_sink;
+  mb::logging::TSDBSink::Config config;
+  uint8_t                       export_buffer[ 256 ];
+  mb::logging::ExportIndex      export_index[ 32 ];
+
+  static constexpr size_t NUM_RECORDS = 40;
+
+  /**
+   * Every successful call either moves at least one record or finishes the
+   * cursor, so a full export can never need more calls than this.
+   */
+  static constexpr size_t max_export_calls( const size_t num_records )
+  {
+    return num_records + 1;
+  }
+
+  void setup() override
+  {
+    TSDBSinkFixture::setup();
+
+    /*-------------------------------------------------------------------------
+    Configure the sink
+    -------------------------------------------------------------------------*/
+    expect::mb$::osal$::createRecursiveMutex( IgnoreParameter(), true );
+
+    test_sink = new mb::logging::TSDBSink();
+
+    config.dev_name      = "nor_flash_0";
+    config.part_name     = "logging";
+    config.max_log_size  = 256;
+    config.reader_buffer = nullptr;
+
+    test_sink->configure( config );
+    test_sink->enabled  = true;
+    test_sink->logLevel = mb::logging::Level::LVL_INFO;
+    CHECK( test_sink->open() == mb::logging::ErrCode::ERR_OK );
+
+    for( size_t i = 0; i < NUM_RECORDS; i++ )
+    {
+      write_record( i );
+    }
+  }
+
+  void teardown() override
+  {
+    delete test_sink;
+
+    TSDBSinkFixture::teardown();
+  }
+
+  void write_record( const size_t idx )
+  {
+    char      message[ 32 ];
+    const int len = snprintf( message, sizeof( message ), "export record %03zu", idx );
+
+    expect::mb$::time$::micros( s_last_micros );
+    s_last_micros += 1000;
+    CHECK( test_sink->write( mb::logging::Level::LVL_INFO, message, len ) == mb::logging::ErrCode::ERR_OK );
+  }
+
+  /**
+   * @brief Checks each record in a chunk against the expected sequence
+   *
+   * @param chunk     Chunk returned by exportChunk()
+   * @param next_idx  Sequence number of the first record in the chunk
+   * @return size_t   Sequence number following the last record in the chunk
+   */
+  size_t verify_chunk( const mb::logging::ExportChunk &chunk, size_t next_idx )
+  {
+    char expected[ 32 ];
+
+    for( const auto &record : chunk.records )
+    {
+      CHECK( ( record.offset + record.length ) <= chunk.data.size() );
+
+      const int len = snprintf( expected, sizeof( expected ), "export record %03zu", next_idx );
+      CHECK_EQUAL( static_cast<size_t>( len ), record.length );
+      CHECK( memcmp( chunk.data.data() + record.offset, expected, len ) == 0 );
+      next_idx++;
+    }
+
+    return next_idx;
+  }
+};
+
+TEST( tsdb_sink_export, bad_arguments )
+{
+  mb::logging::ExportCursor cursor;
+  mb::logging::ExportChunk  chunk;
+
+  /*---------------------------------------------------------------------------
+  Test Case: No data buffer
+  ---------------------------------------------------------------------------*/
+  CHECK( test_sink->exportChunk( cursor, {}, export_index, chunk ) == mb::logging::ErrCode::ERR_FAIL );
+
+  /*---------------------------------------------------------------------------
+  Test Case: No record index
+  ---------------------------------------------------------------------------*/
+  CHECK( test_sink->exportChunk( cursor, export_buffer, {}, chunk ) == mb::logging::ErrCode::ERR_FAIL );
+
+  /*---------------------------------------------------------------------------
+  Test Case: Buffer cannot hold even a single record; cursor must not move
+  ---------------------------------------------------------------------------*/
+  uint8_t tiny[ 4 ];
+  CHECK( test_sink->exportChunk( cursor, tiny, export_index, chunk ) == mb::logging::ErrCode::ERR_FAIL );
+  CHECK( !cursor.done() );
+  CHECK( chunk.records.empty() );
+}
+
+TEST( tsdb_sink_export, export_everything_in_chunks )
+{
+  mb::logging::ExportCursor cursor;
+  mb::logging::ExportChunk  chunk;
+  size_t                    next_idx   = 0;
+  size_t                    num_chunks = 0;
+  size_t                    num_calls  = 0;
+
+  while( !cursor.done() )
+  {
+    if( ++num_calls > max_export_calls( NUM_RECORDS ) )
+    {
+      FAIL( "Export cursor never reported done" );
+    }
+
+    CHECK( test_sink->exportChunk( cursor, export_buffer, export_index, chunk ) == mb::logging::ErrCode::ERR_OK );
+    next_idx = verify_chunk( chunk, next_idx );
+
+    if( !chunk.records.empty() )
+    {
+      num_chunks++;
+    }
+  }
+
+  /*---------------------------------------------------------------------------
+  Test Case: Every record exported exactly once, several per slice
+  ---------------------------------------------------------------------------*/
+  CHECK_EQUAL( NUM_RECORDS, next_idx );
+  CHECK( num_chunks > 1 );
+  CHECK( num_chunks < NUM_RECORDS );
+}
+
+TEST( tsdb_sink_export, index_limits_records_per_chunk )
+{
+  mb::logging::ExportCursor cursor;
+  mb::logging::ExportChunk  chunk;
+
+  CHECK( test_sink->exportChunk( cursor, export_buffer, etl::span<mb::logging::ExportIndex>( export_index, 2 ), chunk ) ==
+         mb::logging::ErrCode::ERR_OK );
+  CHECK_EQUAL( 2, chunk.records.size() );
+  CHECK_EQUAL( 2, verify_chunk( chunk, 0 ) );
+}
+
+TEST( tsdb_sink_export, resume_from_saved_cursor )
+{
+  mb::logging::ExportCursor cursor;
+  mb::logging::ExportChunk  chunk;
+
+  /*---------------------------------------------------------------------------
+  Export the first slice, then save the cursor as a host would between RPCs
+  ---------------------------------------------------------------------------*/
+  CHECK( test_sink->exportChunk( cursor, export_buffer, export_index, chunk ) == mb::logging::ErrCode::ERR_OK );
+  size_t next_idx = verify_chunk( chunk, 0 );
+  CHECK( next_idx > 0 );
+
+  mb::logging::ExportCursor saved;
+  memcpy( &saved, &cursor, sizeof( saved ) );
+
+  /*---------------------------------------------------------------------------
+  More records arrive before the transfer resumes
+  ---------------------------------------------------------------------------*/
+  for( size_t i = NUM_RECORDS; i < NUM_RECORDS + 5; i++ )
+  {
+    write_record( i );
+  }
+
+  /*---------------------------------------------------------------------------
+  Test Case: Resuming continues exactly where the last slice ended
+  ---------------------------------------------------------------------------*/
+  size_t num_calls = 0;
+  while( !saved.done() )
+  {
+    if( ++num_calls > max_export_calls( NUM_RECORDS + 5 ) )
+    {
+      FAIL( "Resumed export cursor never reported done" );
+    }
+
+    CHECK( test_sink->exportChunk( saved, export_buffer, export_index, chunk ) == mb::logging::ErrCode::ERR_OK );
+    next_idx = verify_chunk( chunk, next_idx );
+  }
+
+  CHECK_EQUAL( NUM_RECORDS + 5, next_idx );
+}
+
+/*-----------------------------------------------------------------------------
+Test Case: Retained RAM crash buffer
+-----------------------------------------------------------------------------*/
+
+TEST_GROUP_BASE( tsdb_sink_crash_log, TSDBSinkFixture )
+{
+  mb::logging::TSDBSink::Config config;
+  uint8_t                       retained_ram[ 512 ];
+  uint8_t                       retained_snapshot[ 512 ];
+
+  void setup() override
+  {
+    TSDBSinkFixture::setup();
+
+    memset( retained_ram, 0, sizeof( retained_ram ) );
+    memset( retained_snapshot, 0, sizeof( retained_snapshot ) );
+    s_read_results.clear();
+
+    config.dev_name          = "nor_flash_0";
+    config.part_name         = "logging";
+    config.max_log_size      = 256;
+    config.reader_buffer     = new uint8_t[ 512 ];
+    config.batch_buffer      = new uint8_t[ 256 ];
+    config.crash_buffer      = retained_ram;
+    config.crash_buffer_size = sizeof( retained_ram );
+  }
+
+  void teardown() override
+  {
+    delete[] config.batch_buffer;
+    delete[] config.reader_buffer;
+
+    TSDBSinkFixture::teardown();
+  }
+
+  mb::logging::TSDBSink *create_sink()
+  {
+    expect::mb$::osal$::createRecursiveMutex( IgnoreParameter(), true );
+
+    auto sink = new mb::logging::TSDBSink();
+    sink->configure( config );
+    sink->enabled  = true;
+    sink->logLevel = mb::logging::Level::LVL_INFO;
+    CHECK( sink->open() == mb::logging::ErrCode::ERR_OK );
+
+    return sink;
+  }
+
+  /**
+   * @brief Logs a few lines that only live in the volatile batch, then
+   * simulates a fault: retained RAM survives, flash never saw the lines.
+   */
+  void log_then_crash( const size_t count )
+  {
+    auto sink = create_sink();
+
+    char message[ 16 ];
+    for( size_t i = 0; i < count; i++ )
+    {
+      const int len = snprintf( message, sizeof( message ), "last words %zu", i );
+
+      expect::mb$::time$::micros( s_last_micros );
+      s_last_micros += 1000;
+      CHECK( sink->write( mb::logging::Level::LVL_INFO, message, len ) == mb::logging::ErrCode::ERR_OK );
+    }
+
+    memcpy( retained_snapshot, retained_ram, sizeof( retained_ram ) );
+
+    /*-------------------------------------------------------------------------
+    Tear everything down as a reset would: the batch is lost, flash is wiped
+    back to the state it was in before the lines were logged, and retained
+    RAM comes back as it was at the moment of the fault.
+    -------------------------------------------------------------------------*/
+    delete sink;
+    close_flash();
+    open_flash( true );
+
+    memcpy( retained_ram, retained_snapshot, sizeof( retained_ram ) );
+  }
+};
+
+TEST( tsdb_sink_crash_log, crash_buffer_too_small )
+{
+  config.crash_buffer_size = 4;
+
+  expect::mb$::osal$::createRecursiveMutex( IgnoreParameter(), true );
+  auto sink = new mb::logging::TSDBSink();
+  sink->configure( config );
+  CHECK( sink->open() == mb::logging::ErrCode::ERR_FAIL );
+  delete sink;
+}
+
+TEST( tsdb_sink_crash_log, recovered_on_next_open )
+{
+  /*---------------------------------------------------------------------------
+  Reference: the flash writes a boot on an empty partition costs, and what
+  committing the same three lines as one batch adds on top of it.
+  ---------------------------------------------------------------------------*/
+  size_t       start_calls = s_flash_write_calls;
+  auto         sink        = create_sink();
+  const size_t boot_calls  = s_flash_write_calls - start_calls;
+
+  char message[ 16 ];
+  for( size_t i = 0; i < 3; i++ )
+  {
+    const int len = snprintf( message, sizeof( message ), "last words %zu", i );
+
+    expect::mb$::time$::micros( s_last_micros );
+    s_last_micros += 1000;
+    CHECK( sink->write( mb::logging::Level::LVL_INFO, message, len ) == mb::logging::ErrCode::ERR_OK );
+  }
+
+  start_calls = s_flash_write_calls;
+  CHECK( sink->flush() == mb::logging::ErrCode::ERR_OK );
+  const size_t append_calls = s_flash_write_calls - start_calls;
+  CHECK( append_calls > 0 );
+
+  delete sink;
+  close_flash();
+  open_flash( true );
+  memset( retained_ram, 0, sizeof( retained_ram ) );
+
+  log_then_crash( 3 );
+
+  /*---------------------------------------------------------------------------
+  Test Case: The next boot commits the crash buffer as a single TSDB append
+  ---------------------------------------------------------------------------*/
+  start_calls = s_flash_write_calls;
+  sink        = create_sink();
+  CHECK_EQUAL( boot_calls + append_calls, s_flash_write_calls - start_calls );
+
+  sink->read( mb::logging::LogReader::create<cb_read_collect>(), true );
+  CHECK_EQUAL( 3, s_read_results.size() );
+  CHECK( s_read_results[ 0 ] == "last words 0" );
+  CHECK( s_read_results[ 2 ] == "last words 2" );
+
+  CHECK( sink->close() == mb::logging::ErrCode::ERR_OK );
+  delete sink;
+
+  /*---------------------------------------------------------------------------
+  Test Case: Once committed, the crash buffer is not replayed again
+  ---------------------------------------------------------------------------*/
+  s_read_results.clear();
+  close_flash();
+  open_flash( false );
+
+  sink = create_sink();
+  sink->read( mb::logging::LogReader::create<cb_read_collect>(), true );
+  CHECK_EQUAL( 3, s_read_results.size() );
+  delete sink;
+}
+
+TEST( tsdb_sink_crash_log, corrupted_buffer_is_ignored )
+{
+  log_then_crash( 3 );
+
+  /* Flip a bit in the first payload byte so the CRC no longer matches */
+  static_assert( sizeof( mb::logging::CrashBufferHeader ) < sizeof( retained_ram ), "Header must fit" );
+  retained_ram[ sizeof( mb::logging::CrashBufferHeader ) ] ^= 0x01;
+
+  auto sink = create_sink();
+  sink->read( mb::logging::LogReader::create<cb_read_collect>(), true );
+  CHECK( s_read_results.empty() );
+
+  delete sink;
+}
+
+TEST( tsdb_sink_crash_log, uninitialized_ram_is_ignored )
+{
+  /* Power-on RAM contents are arbitrary */
+  memset( retained_ram, 0xA5, sizeof( retained_ram ) );
+
+  auto sink = create_sink();
+  sink->read( mb::logging::LogReader::create<cb_read_collect>(), true );
+  CHECK( s_read_results.empty() );
+
+  delete sink;
+}
+
+TEST( tsdb_sink_crash_log, flush_clears_crash_buffer )
+{
+  auto sink = create_sink();
+
+  expect::mb$::time$::micros( s_last_micros );
+  s_last_micros += 1000;
+  CHECK( sink->write( mb::logging::Level::LVL_INFO, "durable", 7 ) == mb::logging::ErrCode::ERR_OK );
+  CHECK( sink->flush() == mb::logging::ErrCode::ERR_OK );
+
+  /*---------------------------------------------------------------------------
+  Test Case: Data already in flash is not duplicated on the next boot
+  ---------------------------------------------------------------------------*/
+  memcpy( retained_snapshot, retained_ram, sizeof( retained_ram ) );
+  delete sink;
+
+  close_flash();
+  open_flash( false );
+  memcpy( retained_ram, retained_snapshot, sizeof( retained_ram ) );
+
+  sink = create_sink();
+  sink->read( mb::logging::LogReader::create<cb_read_collect>(), true );
+  CHECK_EQUAL( 1, s_read_results.size() );
+  CHECK( s_read_results[ 0 ] == "durable" );
+
+  delete sink;
+}
+
+/*-----------------------------------------------------------------------------
+Test Case: Structured (nanopb encoded) records
+-----------------------------------------------------------------------------*/
+
+namespace structured = mb::logging::structured;
+
+static constexpr uint32_t MSG_ID_BATTERY = 0x100;
+static constexpr uint32_t MSG_ID_SENSOR  = 0x200;
+static constexpr uint32_t KEY_VOLTAGE    = 1;
+static constexpr uint32_t KEY_CHARGING   = 2;
+static constexpr uint32_t KEY_CHANNEL    = 3;
+static constexpr uint32_t KEY_TEMP       = 4;
+static constexpr uint32_t KEY_NAME       = 5;
+
+/**
+ * @brief LogReader that keeps the raw encoded bytes of each record
+ */
+static etl::vector<etl::vector<uint8_t, 128>, 8> s_encoded_results;
+static bool cb_read_encoded( const void *const message, const size_t length )
+{
+  auto bytes = static_cast<const uint8_t *>( message );
+  s_encoded_results.push_back( etl::vector<uint8_t, 128>( bytes, bytes + length ) );
+  return false; // Keep reading the next log
+}
+
+TEST_GROUP_BASE( tsdb_sink_structured, TSDBSinkFixture )
+{
+  mb::logging::TSDBSink        *test_sink;
+  mb::logging::TSDBSink::Config config;
+
+  void setup() override
+  {
+    TSDBSinkFixture::setup();
+    s_encoded_results.clear();
+
+    expect::mb$::osal$::createRecursiveMutex( IgnoreParameter(), true );
+    test_sink = new mb::logging::TSDBSink();
+
+    config.dev_name      = "nor_flash_0";
+    config.part_name     = "logging";
+    config.max_log_size  = 256;
+    config.reader_buffer = new uint8_t[ 512 ];
+
+    test_sink->configure( config );
+    test_sink->enabled  = true;
+    test_sink->logLevel = mb::logging::Level::LVL_INFO;
+    CHECK( test_sink->open() == mb::logging::ErrCode::ERR_OK );
+  }
+
+  void teardown() override
+  {
+    delete test_sink;
+    delete[] config.reader_buffer;
+
+    TSDBSinkFixture::teardown();
+  }
+
+  mb::logging::ErrCode write_record( const structured::Record &record )
+  {
+    expect::mb$::time$::micros( s_last_micros );
+    s_last_micros += 1000;
+    return test_sink->writeRecord( record );
+  }
+};
+
+TEST( tsdb_sink_structured, record_builder_limits )
+{
+  structured::Record record( MSG_ID_SENSOR, mb::logging::Level::LVL_INFO );
+
+  /*---------------------------------------------------------------------------
+  Test Case: Field table fills up
+  ---------------------------------------------------------------------------*/
+  for( size_t i = 0; i < structured::MAX_FIELDS; i++ )
+  {
+    CHECK( record.add( static_cast<uint32_t>( i ), static_cast<int64_t>( i ) ) );
+  }
+  CHECK_FALSE( record.add( KEY_CHANNEL, static_cast<int64_t>( 0 ) ) );
+  CHECK_EQUAL( structured::MAX_FIELDS, record.size() );
+
+  /*---------------------------------------------------------------------------
+  Test Case: Strings longer than a field can hold are rejected
+  ---------------------------------------------------------------------------*/
+  structured::Record short_record( MSG_ID_SENSOR, mb::logging::Level::LVL_INFO );
+  char               long_name[ structured::MAX_STRING_LEN + 2 ];
+
+  memset( long_name, 'a', sizeof( long_name ) - 1 );
+  long_name[ sizeof( long_name ) - 1 ] = '\0';
+  CHECK_FALSE( short_record.add( KEY_NAME, long_name ) );
+  CHECK_EQUAL( 0, short_record.size() );
+}
+
+TEST( tsdb_sink_structured, write_bad_args )
+{
+  structured::Record record( MSG_ID_BATTERY, mb::logging::Level::LVL_DEBUG );
+  record.add( KEY_VOLTAGE, 3.7f );
+
+  /*---------------------------------------------------------------------------
+  Test Case: Not enabled
+  ---------------------------------------------------------------------------*/
+  test_sink->enabled = false;
+  CHECK( test_sink->writeRecord( record ) == mb::logging::ErrCode::ERR_FAIL );
+
+  /*---------------------------------------------------------------------------
+  Test Case: Record level below the sink level
+  ---------------------------------------------------------------------------*/
+  test_sink->enabled = true;
+  CHECK( test_sink->writeRecord( record ) == mb::logging::ErrCode::ERR_FAIL );
+}
+
+TEST( tsdb_sink_structured, round_trip_through_decoder )
+{
+  /*---------------------------------------------------------------------------
+  Write one record of each shape
+  ---------------------------------------------------------------------------*/
+  const int64_t battery_time = s_last_micros;
+
+  structured::Record battery( MSG_ID_BATTERY, mb::logging::Level::LVL_WARN );
+  CHECK( battery.add( KEY_VOLTAGE, 3.25f ) );
+  CHECK( battery.add( KEY_CHARGING, false ) );
+  CHECK( write_record( battery ) == mb::logging::ErrCode::ERR_OK );
+
+  structured::Record sensor( MSG_ID_SENSOR, mb::logging::Level::LVL_INFO );
+  CHECK( sensor.add( KEY_CHANNEL, static_cast<uint64_t>( 7 ) ) );
+  CHECK( sensor.add( KEY_TEMP, static_cast<int64_t>( -40 ) ) );
+  CHECK( sensor.add( KEY_NAME, "imu" ) );
+  CHECK( write_record( sensor ) == mb::logging::ErrCode::ERR_OK );
+
+  test_sink->read( mb::logging::LogReader::create<cb_read_encoded>(), true );
+  CHECK_EQUAL( 2, s_encoded_results.size() );
+
+  /*---------------------------------------------------------------------------
+  Test Case: Header fields survive the round trip
+  ---------------------------------------------------------------------------*/
+  structured::DecodedRecord decoded;
+  CHECK( structured::decode( s_encoded_results[ 0 ].data(), s_encoded_results[ 0 ].size(), decoded ) );
+  CHECK_EQUAL( MSG_ID_BATTERY, decoded.msg_id );
+  CHECK( decoded.level == mb::logging::Level::LVL_WARN );
+  CHECK_EQUAL( battery_time, decoded.timestamp );
+  CHECK_EQUAL( 2, decoded.fields.size() );
+
+  CHECK_EQUAL( KEY_VOLTAGE, decoded.fields[ 0 ].key );
+  CHECK( decoded.fields[ 0 ].type == structured::FieldType::FLOAT );
+  DOUBLES_EQUAL( 3.25, decoded.fields[ 0 ].float_value, 1e-6 );
+
+  CHECK_EQUAL( KEY_CHARGING, decoded.fields[ 1 ].key );
+  CHECK( decoded.fields[ 1 ].type == structured::FieldType::BOOL );
+  CHECK_FALSE( decoded.fields[ 1 ].bool_value );
+
+  /*---------------------------------------------------------------------------
+  Test Case: Every value type keeps its type and value
+  ---------------------------------------------------------------------------*/
+  CHECK( structured::decode( s_encoded_results[ 1 ].data(), s_encoded_results[ 1 ].size(), decoded ) );
+  CHECK_EQUAL( MSG_ID_SENSOR, decoded.msg_id );
+  CHECK( decoded.level == mb::logging::Level::LVL_INFO );
+  CHECK_EQUAL( 3, decoded.fields.size() );
+
+  CHECK( decoded.fields[ 0 ].type == structured::FieldType::UNSIGNED );
+  CHECK_EQUAL( 7, decoded.fields[ 0 ].uint_value );
+
+  CHECK( decoded.fields[ 1 ].type == structured::FieldType::SIGNED );
+  CHECK_EQUAL( -40, decoded.fields[ 1 ].int_value );
+
+  CHECK( decoded.fields[ 2 ].type == structured::FieldType::STRING );
+  STRCMP_EQUAL( "imu", decoded.fields[ 2 ].string_value.c_str() );
+}
+
+TEST( tsdb_sink_structured, decode_rejects_bad_input )
+{
+  structured::DecodedRecord decoded;
+
+  /*---------------------------------------------------------------------------
+  Test Case: Null or empty input
+  ---------------------------------------------------------------------------*/
+  CHECK_FALSE( structured::decode( nullptr, 10, decoded ) );
+
+  /*---------------------------------------------------------------------------
+  Test Case: Truncated record
+  ---------------------------------------------------------------------------*/
+  structured::Record record( MSG_ID_SENSOR, mb::logging::Level::LVL_INFO );
+  CHECK( record.add( KEY_NAME, "accelerometer" ) );
+
+  uint8_t      buffer[ 128 ];
+  const size_t encoded_size = structured::encode( record, 0, buffer, sizeof( buffer ) );
+  CHECK( encoded_size > 4 );
+  CHECK( structured::decode( buffer, encoded_size, decoded ) );
+  CHECK_FALSE( structured::decode( buffer, encoded_size - 4, decoded ) );
+
+  /*---------------------------------------------------------------------------
+  Test Case: Output buffer too small to encode into
+  ---------------------------------------------------------------------------*/
+  CHECK_EQUAL( 0, structured::encode( record, 0, buffer, 4 ) );
+}
+
+TEST( tsdb_sink_structured, filter_by_message_id )
+{
+  for( uint64_t channel = 0; channel < 3; channel++ )
+  {
+    structured::Record sensor( MSG_ID_SENSOR, mb::logging::Level::LVL_INFO );
+    CHECK( sensor.add( KEY_CHANNEL, channel ) );
+    CHECK( write_record( sensor ) == mb::logging::ErrCode::ERR_OK );
+
+    structured::Record battery( MSG_ID_BATTERY, mb::logging::Level::LVL_INFO );
+    CHECK( battery.add( KEY_VOLTAGE, 4.0f ) );
+    CHECK( write_record( battery ) == mb::logging::ErrCode::ERR_OK );
+  }
+
+  test_sink->read( mb::logging::LogReader::create<cb_read_encoded>(), true );
+  CHECK_EQUAL( 6, s_encoded_results.size() );
+
+  /*---------------------------------------------------------------------------
+  Test Case: Host side filtering is a field compare, not a text search
+  ---------------------------------------------------------------------------*/
+  uint64_t expected_channel = 0;
+  for( const auto &bytes : s_encoded_results )
+  {
+    structured::DecodedRecord decoded;
+    CHECK( structured::decode( bytes.data(), bytes.size(), decoded ) );
+    if( decoded.msg_id != MSG_ID_SENSOR )
+    {
+      continue;
+    }
+
+    CHECK_EQUAL( expected_channel, decoded.fields[ 0 ].uint_value );
+    expected_channel++;
+  }
+
+  CHECK_EQUAL( 3, expected_channel );
+}
+
+TEST( tsdb_sink_structured, record_uses_less_flash_than_text )
+{
+  /*---------------------------------------------------------------------------
+  The first append into an empty sector also writes the sector header. Take
+  that hit with a throw-away record so both measurements are steady-state.
+  ---------------------------------------------------------------------------*/
+  const char *text = "battery: voltage=3.25 charging=false channel=7";
+
+  expect::mb$::time$::micros( s_last_micros );
+  s_last_micros += 1000;
+  CHECK( test_sink->write( mb::logging::Level::LVL_INFO, text, strlen( text ) ) == mb::logging::ErrCode::ERR_OK );
+
+  /*---------------------------------------------------------------------------
+  Measure the flash cost of the formatted text record
+  ---------------------------------------------------------------------------*/
+  expect::mb$::time$::micros( s_last_micros );
+  s_last_micros += 1000;
+  size_t start_bytes = s_flash_bytes_written;
+  CHECK( test_sink->write( mb::logging::Level::LVL_INFO, text, strlen( text ) ) == mb::logging::ErrCode::ERR_OK );
+  const size_t text_bytes = s_flash_bytes_written - start_bytes;
+
+  /*---------------------------------------------------------------------------
+  Measure the flash cost of the equivalent structured record
+  ---------------------------------------------------------------------------*/
+  structured::Record record( MSG_ID_BATTERY, mb::logging::Level::LVL_INFO );
+  CHECK( record.add( KEY_VOLTAGE, 3.25f ) );
+  CHECK( record.add( KEY_CHARGING, false ) );
+  CHECK( record.add( KEY_CHANNEL, static_cast<uint64_t>( 7 ) ) );
+
+  const int64_t record_time = s_last_micros;
+
+  start_bytes = s_flash_bytes_written;
+  CHECK( write_record( record ) == mb::logging::ErrCode::ERR_OK );
+  const size_t record_bytes = s_flash_bytes_written - start_bytes;
+
+  /*---------------------------------------------------------------------------
+  Test Case: TSDB framing is identical, so the saving is exactly the text
+  length less the encoded record, header and timestamp included.
+  ---------------------------------------------------------------------------*/
+  uint8_t      encoded[ 128 ];
+  const size_t encoded_size = structured::encode( record, record_time, encoded, sizeof( encoded ) );
+
+  CHECK( encoded_size > 0 );
+  CHECK( record_bytes < text_bytes );
+  CHECK_EQUAL( strlen( text ) - encoded_size, text_bytes - record_bytes );
+}
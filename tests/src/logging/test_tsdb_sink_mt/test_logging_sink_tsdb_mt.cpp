@@ -0,0 +1,355 @@
+/******************************************************************************
+ *  File Name:
+ *    test_logging_sink_tsdb_mt.cpp
+ *
+ *  Description:
+ *    Multi-threaded test cases for the TimeSeries Database logging sink,
+ *    covering snapshot reads that run concurrently with writers.
+ *
+ *  2024 | Brandon Braun | brandonbraun653@protonmail.com
+ *****************************************************************************/
+
+/*-----------------------------------------------------------------------------
+Includes
+-----------------------------------------------------------------------------*/
+
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <etl/string.h>
+#include <future>
+#include <mbedutils/database.hpp>
+#include <mbedutils/logging.hpp>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+#include <CppUTest/TestHarness.h>
+#include <CppUTestExt/MockSupport.h>
+#include <CppUTest/CommandLineTestRunner.h>
+
+#include "nor_flash_file.hpp"
+
+/*-----------------------------------------------------------------------------
+Constants
+-----------------------------------------------------------------------------*/
+
+static constexpr auto   WRITER_TIMEOUT = std::chrono::seconds( 5 );
+static constexpr size_t RECORD_SIZE    = 200;
+
+/*-----------------------------------------------------------------------------
+Static Data
+-----------------------------------------------------------------------------*/
+
+static fake::memory::nor::FileFlash *s_flash_0_driver;
+
+extern "C"
+{
+  const fal_flash_dev fdb_nor_flash0 = {
+    .name     = "nor_flash_0",
+    .addr     = 0x00000000,
+    .len      = 8 * 1024 * 1024,
+    .blk_size = 4096,
+    .ops      = {
+             .init = []( void ) -> int { return 0; },
+        .read                        = []( long offset, uint8_t *buf, size_t size ) -> int {
+          return ( mb::memory::Status::ERR_OK == s_flash_0_driver->read( offset, buf, size ) ) ? 0 : -1;
+        },
+        .write                       = []( long offset, const uint8_t *buf, size_t size ) -> int {
+          return ( mb::memory::Status::ERR_OK == s_flash_0_driver->write( offset, buf, size ) ) ? 0 : -1;
+        },
+        .erase                       = []( long offset, size_t size ) -> int {
+          return ( mb::memory::Status::ERR_OK == s_flash_0_driver->erase( offset, size ) ) ? 0 : -1;
+        },
+    },
+    .write_gran                      = 1
+  };
+}
+
+/*-----------------------------------------------------------------------------
+Static Functions
+-----------------------------------------------------------------------------*/
+
+/**
+ * @brief Lets a test hold a reader inside its LogReader callback.
+ *
+ * The reader announces when it reaches the callback for the first time, then
+ * parks there until the test releases it. Everything the reader sees is kept
+ * for inspection afterwards.
+ */
+static struct ReaderGate
+{
+  std::mutex                    mtx;
+  std::condition_variable       cv;
+  bool                          arrived;
+  bool                          released;
+  std::vector<etl::string<256>> results;
+
+  void reset()
+  {
+    std::lock_guard<std::mutex> lock( mtx );
+    arrived  = false;
+    released = false;
+    results.clear();
+  }
+
+  bool wait_for_arrival()
+  {
+    std::unique_lock<std::mutex> lock( mtx );
+    return cv.wait_for( lock, WRITER_TIMEOUT, [ this ] { return arrived; } );
+  }
+
+  void release()
+  {
+    std::lock_guard<std::mutex> lock( mtx );
+    released = true;
+    cv.notify_all();
+  }
+} s_gate;
+
+static bool cb_read_gated( const void *const message, const size_t length )
+{
+  std::unique_lock<std::mutex> lock( s_gate.mtx );
+  s_gate.results.push_back( etl::string<256>( static_cast<const char *>( message ), length ) );
+
+  if( !s_gate.arrived )
+  {
+    s_gate.arrived = true;
+    s_gate.cv.notify_all();
+    s_gate.cv.wait( lock, [] { return s_gate.released; } );
+  }
+
+  return false; // Keep reading the next log
+}
+
+/**
+ * @brief Builds a fixed size record whose body is derived from its prefix.
+ *
+ * Every byte after the prefix repeats the prefix's checksum, so a record that
+ * was torn or read from a recycled sector is easy to spot.
+ *
+ * @param prefix  Unique record prefix
+ * @return etl::string<256>
+ */
+static etl::string<256> make_record( const char *prefix )
+{
+  etl::string<256> record( prefix );
+
+  uint8_t fill = 0;
+  for( const char c : record )
+  {
+    fill += static_cast<uint8_t>( c );
+  }
+
+  record.resize( RECORD_SIZE, static_cast<char>( 'A' + ( fill % 26 ) ) );
+  return record;
+}
+
+/**
+ * @brief Checks that a record read back matches what make_record() produced
+ *
+ * @param record  Record to check
+ * @return bool
+ */
+static bool record_is_intact( const etl::string<256> &record )
+{
+  const size_t sep = record.find( ' ' );
+  if( ( record.size() != RECORD_SIZE ) || ( sep == etl::string<256>::npos ) )
+  {
+    return false;
+  }
+
+  return record == make_record( etl::string<256>( record.begin(), record.begin() + sep + 1 ).c_str() );
+}
+
+/*-----------------------------------------------------------------------------
+Public Functions
+-----------------------------------------------------------------------------*/
+
+int main( int argc, char **argv )
+{
+  MemoryLeakWarningPlugin::turnOffNewDeleteOverloads();
+  return RUN_ALL_TESTS( argc, argv );
+}
+
+/*-----------------------------------------------------------------------------
+TSDBSink Snapshot Read Tests
+-----------------------------------------------------------------------------*/
+
+TEST_GROUP( tsdb_sink_mt )
+{
+  mb::logging::TSDBSink        *test_sink;
+  mb::logging::TSDBSink::Config config;
+  std::thread                   reader;
+
+  void setup()
+  {
+    /*-------------------------------------------------------------------------
+    Configure the flash devices
+    -------------------------------------------------------------------------*/
+    s_flash_0_driver = new fake::memory::nor::FileFlash();
+
+    mb::memory::nor::DeviceConfig flash_0_cfg;
+    flash_0_cfg.dev_attr.block_size = fdb_nor_flash0.blk_size;
+    flash_0_cfg.dev_attr.size       = fdb_nor_flash0.len;
+
+    std::remove( "flash_0_test_mt.bin" );
+    s_flash_0_driver->open( "flash_0_test_mt.bin", flash_0_cfg );
+
+    mock().clear();
+    mock().ignoreOtherCalls();
+    s_gate.reset();
+
+    /*-------------------------------------------------------------------------
+    Configure the sink
+    -------------------------------------------------------------------------*/
+    test_sink = new mb::logging::TSDBSink();
+
+    config.dev_name      = "nor_flash_0";
+    config.part_name     = "logging";
+    config.max_log_size  = 256;
+    config.reader_buffer = new uint8_t[ 512 ];
+
+    test_sink->configure( config );
+    test_sink->enabled  = true;
+    test_sink->logLevel = mb::logging::Level::LVL_INFO;
+    CHECK( test_sink->open() == mb::logging::ErrCode::ERR_OK );
+  }
+
+  void teardown()
+  {
+    /*-------------------------------------------------------------------------
+    Never leave a reader parked, even if a check failed
+    -------------------------------------------------------------------------*/
+    s_gate.release();
+    if( reader.joinable() )
+    {
+      reader.join();
+    }
+
+    mock().checkExpectations();
+
+    delete test_sink;
+    delete[] config.reader_buffer;
+
+    s_flash_0_driver->close();
+    delete s_flash_0_driver;
+
+    mock().clear();
+  }
+
+  /**
+   * @brief Appends numbered records and returns how many writes failed.
+   *
+   * No CHECKs in here: this also runs on worker threads, where a failing
+   * CppUTest check is not safe. Callers assert on the returned count.
+   */
+  size_t write_records( const char *tag, const size_t count )
+  {
+    size_t failures = 0;
+
+    for( size_t i = 0; i < count; i++ )
+    {
+      char prefix[ 32 ];
+      snprintf( prefix, sizeof( prefix ), "%s-%05zu ", tag, i );
+
+      const auto record = make_record( prefix );
+      if( test_sink->write( mb::logging::Level::LVL_INFO, record.data(), record.size() ) != mb::logging::ErrCode::ERR_OK )
+      {
+        failures++;
+      }
+    }
+
+    return failures;
+  }
+
+  void start_parked_reader()
+  {
+    reader = std::thread( [ this ] { test_sink->read( mb::logging::LogReader::create<cb_read_gated>(), true ); } );
+    CHECK( s_gate.wait_for_arrival() );
+  }
+};
+
+
+TEST( tsdb_sink_mt, writer_not_blocked_by_reader )
+{
+  CHECK_EQUAL( 0, write_records( "pre", 10 ) );
+  start_parked_reader();
+
+  /*---------------------------------------------------------------------------
+  Test Case: Writes complete while the reader is parked mid-iteration
+  ---------------------------------------------------------------------------*/
+  std::atomic<size_t> writer_errors = 0;
+
+  auto writer = std::async( std::launch::async, [ this, &writer_errors ] { writer_errors += write_records( "live", 50 ); } );
+  const bool writer_finished = ( writer.wait_for( WRITER_TIMEOUT ) == std::future_status::ready );
+
+  s_gate.release();
+  reader.join();
+  writer.get();
+
+  CHECK( writer_finished );
+  CHECK_EQUAL( 0, writer_errors.load() );
+}
+
+TEST( tsdb_sink_mt, snapshot_excludes_later_appends )
+{
+  CHECK_EQUAL( 0, write_records( "pre", 10 ) );
+  start_parked_reader();
+
+  CHECK_EQUAL( 0, write_records( "late", 10 ) );
+
+  s_gate.release();
+  reader.join();
+
+  /*---------------------------------------------------------------------------
+  Test Case: The reader sees exactly the records present when it started
+  ---------------------------------------------------------------------------*/
+  CHECK_EQUAL( 10, s_gate.results.size() );
+  for( size_t i = 0; i < s_gate.results.size(); i++ )
+  {
+    char prefix[ 32 ];
+    snprintf( prefix, sizeof( prefix ), "pre-%05zu ", i );
+
+    CHECK( s_gate.results[ i ] == make_record( prefix ) );
+  }
+
+  /*---------------------------------------------------------------------------
+  Test Case: A new read picks up the appended records
+  ---------------------------------------------------------------------------*/
+  s_gate.reset();
+  s_gate.arrived = true; // Don't park this time
+
+  test_sink->read( mb::logging::LogReader::create<cb_read_gated>(), true );
+  CHECK_EQUAL( 20, s_gate.results.size() );
+}
+
+TEST( tsdb_sink_mt, reader_survives_sector_recycle )
+{
+  CHECK_EQUAL( 0, write_records( "pre", 100 ) );
+  start_parked_reader();
+
+  /*---------------------------------------------------------------------------
+  Write enough to wrap the partition, recycling the sectors the reader's
+  snapshot still points into.
+  ---------------------------------------------------------------------------*/
+  CHECK_EQUAL( 0, write_records( "wrap", 8000 ) );
+
+  s_gate.release();
+  reader.join();
+
+  /*---------------------------------------------------------------------------
+  Test Case: Records from recycled sectors are skipped, never torn
+  ---------------------------------------------------------------------------*/
+  CHECK( !s_gate.results.empty() );
+  CHECK( s_gate.results.size() <= 100 );
+
+  for( const auto &record : s_gate.results )
+  {
+    CHECK( record_is_intact( record ) );
+    CHECK( strncmp( record.c_str(), "pre-", 4 ) == 0 );
+  }
+}
@@ -0,0 +1,462 @@
+/******************************************************************************
+ *  File Name:
+ *    bench_nor_read_cache.cpp
+ *
+ *  Description:
+ *    Benchmark for the nor::DeviceDriver read cache. Runs FlashDB KV lookups
+ *    and TSDB scans on FileFlash behind the TimedFileFlash model, first with
+ *    the read cache model disabled and then with it enabled, and reports bus
+ *    reads, simulated bus time and cache hits/misses as JSON.
+ *
+ *  2024 | Brandon Braun | brandonbraun653@protonmail.com
+ *****************************************************************************/
+
+/*-----------------------------------------------------------------------------
+Includes
+-----------------------------------------------------------------------------*/
+
+#include <algorithm>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <flashdb.h>
+#include <mbedutils/drivers/memory/nvm/nor_flash.hpp>
+
+#include <CppUTestExt/MockSupport.h>
+
+#include "nor_flash_file.hpp"
+
+#include <tests/harness/nor_flash_timing.hpp>
+
+using TestHarness::s_flash_0_timed;
+using TestHarness::s_flash_timing;
+
+/*-----------------------------------------------------------------------------
+Structures
+-----------------------------------------------------------------------------*/
+
+/**
+ * @brief Benchmark parameters, settable from the command line
+ */
+struct BenchConfig
+{
+  size_t      cache_pages = 8;       /**< Pages held by the read cache model */
+  size_t      page_size   = 256;     /**< Bytes per cached page, the driver's read_size */
+  size_t      keys        = 64;      /**< Distinct KV keys */
+  size_t      updates     = 8;       /**< Times each key is rewritten before measuring */
+  size_t      records     = 2000;    /**< TSDB records appended before measuring */
+  size_t      queries     = 16;      /**< Time-bounded TSDB queries per run */
+  const char *output      = nullptr; /**< JSON output file, stdout if null */
+};
+
+/**
+ * @brief Outcome of one measured run
+ */
+struct CacheRun
+{
+  TestHarness::FlashTimingStats stats;   /**< Flash traffic during the measured section */
+  size_t                        results; /**< Values or records handed back, for cross-checking */
+};
+
+/*-----------------------------------------------------------------------------
+Static Data
+-----------------------------------------------------------------------------*/
+
+static fake::memory::nor::FileFlash *s_flash_0_driver;
+static fdb_time_t                    s_now = 0;
+
+extern "C"
+{
+  const fal_flash_dev fdb_nor_flash0 = {
+    .name     = "nor_flash_0",
+    .addr     = 0x00000000,
+    .len      = 8 * 1024 * 1024,
+    .blk_size = 4096,
+    .ops      = {
+             .init = []( void ) -> int { return 0; },
+        .read                        = []( long offset, uint8_t *buf, size_t size ) -> int {
+          return ( mb::memory::Status::ERR_OK == s_flash_0_timed.read( offset, buf, size ) ) ? 0 : -1;
+        },
+        .write                       = []( long offset, const uint8_t *buf, size_t size ) -> int {
+          return ( mb::memory::Status::ERR_OK == s_flash_0_timed.write( offset, buf, size ) ) ? 0 : -1;
+        },
+        .erase                       = []( long offset, size_t size ) -> int {
+          return ( mb::memory::Status::ERR_OK == s_flash_0_timed.erase( offset, size ) ) ? 0 : -1;
+        },
+    },
+    .write_gran                      = 1
+  };
+}
+
+/*-----------------------------------------------------------------------------
+Static Functions
+-----------------------------------------------------------------------------*/
+
+/**
+ * @brief Prints command line usage
+ *
+ * @param name  Executable name
+ */
+static void print_usage( const char *name )
+{
+  fprintf( stderr,
+           "Usage: %s [options]\n"
+           "  --cache-pages <count> Pages held by the read cache (default 8)\n"
+           "  --page-size <bytes>   Bytes per cached page (default 256)\n"
+           "  --keys <count>        Distinct KV keys (default 64)\n"
+           "  --updates <count>     Rewrites of each key before measuring (default 8)\n"
+           "  --records <count>     TSDB records appended before measuring (default 2000)\n"
+           "  --queries <count>     Time-bounded TSDB queries (default 16)\n"
+           "  --output <file>       Write the JSON report here instead of stdout\n",
+           name );
+}
+
+/**
+ * @brief Parses the command line into a benchmark configuration
+ *
+ * @param argc    Number of arguments
+ * @param argv    Argument list
+ * @param cfg     Configuration to fill
+ * @return bool   True if the arguments were valid
+ */
+static bool parse_args( int argc, char **argv, BenchConfig &cfg )
+{
+  for( int i = 1; i < argc; i++ )
+  {
+    const char *arg   = argv[ i ];
+    const char *value = ( i + 1 < argc ) ? argv[ i + 1 ] : nullptr;
+
+    if( !value )
+    {
+      return false;
+    }
+
+    if( strcmp( arg, "--cache-pages" ) == 0 )
+    {
+      cfg.cache_pages = strtoul( value, nullptr, 0 );
+    }
+    else if( strcmp( arg, "--page-size" ) == 0 )
+    {
+      cfg.page_size = strtoul( value, nullptr, 0 );
+    }
+    else if( strcmp( arg, "--keys" ) == 0 )
+    {
+      cfg.keys = strtoul( value, nullptr, 0 );
+    }
+    else if( strcmp( arg, "--updates" ) == 0 )
+    {
+      cfg.updates = strtoul( value, nullptr, 0 );
+    }
+    else if( strcmp( arg, "--records" ) == 0 )
+    {
+      cfg.records = strtoul( value, nullptr, 0 );
+    }
+    else if( strcmp( arg, "--queries" ) == 0 )
+    {
+      cfg.queries = strtoul( value, nullptr, 0 );
+    }
+    else if( strcmp( arg, "--output" ) == 0 )
+    {
+      cfg.output = value;
+    }
+    else
+    {
+      return false;
+    }
+
+    i++;
+  }
+
+  return ( cfg.cache_pages > 0 ) && ( cfg.page_size > 0 ) && ( cfg.keys > 0 ) && ( cfg.records > 0 );
+}
+
+/**
+ * @brief Creates a fresh, empty backing file behind the timing model
+ */
+static void open_flash()
+{
+  s_flash_0_driver = new fake::memory::nor::FileFlash();
+
+  mb::memory::nor::DeviceConfig flash_0_cfg;
+  TestHarness::configure_timed_flash( flash_0_cfg, fdb_nor_flash0.blk_size, fdb_nor_flash0.len );
+
+  std::remove( "flash_0_cache_bench.bin" );
+  s_flash_0_driver->open( "flash_0_cache_bench.bin", flash_0_cfg );
+  s_flash_0_timed.attach( s_flash_0_driver, flash_0_cfg, s_flash_timing );
+  s_flash_0_timed.enable_read_cache( 0, 0 );
+}
+
+/**
+ * @brief Releases the flash device created by open_flash()
+ */
+static void close_flash()
+{
+  s_flash_0_driver->close();
+  delete s_flash_0_driver;
+  s_flash_0_driver = nullptr;
+}
+
+/**
+ * @brief Starts the measured section of a run from a cold cache
+ *
+ * @param cache_pages  Pages in the read cache model, zero to disable it
+ * @param page_size    Bytes per cached page
+ */
+static void start_measuring( const size_t cache_pages, const size_t page_size )
+{
+  s_flash_0_timed.enable_read_cache( cache_pages, page_size );
+  s_flash_0_timed.reset();
+}
+
+/**
+ * @brief TSDB clock that advances one tick per appended record
+ */
+static fdb_time_t get_time( void )
+{
+  return ++s_now;
+}
+
+/**
+ * @brief Fills a KV database with several versions of each key, then times a
+ * re-open (sector scan) followed by one lookup of every key.
+ *
+ * @param cfg          Benchmark configuration
+ * @param cache_pages  Pages in the read cache model, zero to disable it
+ * @param run          Output: measurements
+ * @return bool        True if the database opened and every key was found
+ */
+static bool run_kv( const BenchConfig &cfg, const size_t cache_pages, CacheRun &run )
+{
+  struct fdb_kvdb kvdb = {};
+  struct fdb_blob blob;
+  char            key[ 16 ];
+  uint32_t        value[ 8 ];
+
+  open_flash();
+
+  if( fdb_kvdb_init( &kvdb, "bench_kv", "kv_db", nullptr, nullptr ) != FDB_NO_ERR )
+  {
+    close_flash();
+    return false;
+  }
+
+  /*---------------------------------------------------------------------------
+  Leave stale copies of every key behind so lookups have to skip over them
+  ---------------------------------------------------------------------------*/
+  for( size_t round = 0; round < cfg.updates; round++ )
+  {
+    for( size_t i = 0; i < cfg.keys; i++ )
+    {
+      snprintf( key, sizeof( key ), "key_%03zu", i );
+      for( auto &word : value )
+      {
+        word = static_cast<uint32_t>( ( round << 16 ) | i );
+      }
+
+      fdb_kv_set_blob( &kvdb, key, fdb_blob_make( &blob, value, sizeof( value ) ) );
+    }
+  }
+
+  fdb_kvdb_deinit( &kvdb );
+
+  /*---------------------------------------------------------------------------
+  Measured: open the database again, then look up every key once
+  ---------------------------------------------------------------------------*/
+  start_measuring( cache_pages, cfg.page_size );
+  memset( &kvdb, 0, sizeof( kvdb ) );
+
+  bool ok     = ( fdb_kvdb_init( &kvdb, "bench_kv", "kv_db", nullptr, nullptr ) == FDB_NO_ERR );
+  run.results = 0;
+
+  for( size_t i = 0; ok && ( i < cfg.keys ); i++ )
+  {
+    snprintf( key, sizeof( key ), "key_%03zu", i );
+    if( fdb_kv_get_blob( &kvdb, key, fdb_blob_make( &blob, value, sizeof( value ) ) ) == sizeof( value ) )
+    {
+      run.results++;
+    }
+  }
+
+  run.stats = s_flash_0_timed.stats();
+
+  fdb_kvdb_deinit( &kvdb );
+  close_flash();
+
+  return ok && ( run.results == cfg.keys );
+}
+
+static bool cb_count_tsl( fdb_tsl_t tsl, void *arg )
+{
+  ( void )tsl;
+  ( *static_cast<size_t *>( arg ) )++;
+  return false; // Keep iterating
+}
+
+/**
+ * @brief Fills a TSDB partition, then times a re-open (sector scan), a full
+ * forward scan and a set of time-bounded queries.
+ *
+ * @param cfg          Benchmark configuration
+ * @param cache_pages  Pages in the read cache model, zero to disable it
+ * @param run          Output: measurements
+ * @return bool        True if the database opened and the full scan saw every record
+ */
+static bool run_tsdb( const BenchConfig &cfg, const size_t cache_pages, CacheRun &run )
+{
+  struct fdb_tsdb tsdb = {};
+  struct fdb_blob blob;
+  char            record[ 48 ];
+
+  open_flash();
+  s_now = 0;
+
+  if( fdb_tsdb_init( &tsdb, "bench_ts", "logging", get_time, sizeof( record ), nullptr ) != FDB_NO_ERR )
+  {
+    close_flash();
+    return false;
+  }
+
+  const fdb_time_t first = s_now + 1;
+  for( size_t i = 0; i < cfg.records; i++ )
+  {
+    const int len = snprintf( record, sizeof( record ), "[sensor] channel %zu sample %zu", i % 4, i );
+    fdb_tsl_append( &tsdb, fdb_blob_make( &blob, record, len ) );
+  }
+  const fdb_time_t last = s_now;
+
+  fdb_tsdb_deinit( &tsdb );
+
+  /*---------------------------------------------------------------------------
+  Measured: open again, scan everything, then query evenly spaced windows
+  ---------------------------------------------------------------------------*/
+  start_measuring( cache_pages, cfg.page_size );
+  memset( &tsdb, 0, sizeof( tsdb ) );
+
+  bool   ok   = ( fdb_tsdb_init( &tsdb, "bench_ts", "logging", get_time, sizeof( record ), nullptr ) == FDB_NO_ERR );
+  size_t seen = 0;
+
+  if( ok )
+  {
+    fdb_tsl_iter( &tsdb, cb_count_tsl, &seen );
+    ok = ( seen == cfg.records );
+  }
+
+  const fdb_time_t span   = last - first + 1;
+  const fdb_time_t window = std::max<fdb_time_t>( 1, span / 40 );
+
+  for( size_t q = 0; ok && ( q < cfg.queries ); q++ )
+  {
+    const fdb_time_t from = first + static_cast<fdb_time_t>( ( span * q ) / cfg.queries );
+    fdb_tsl_iter_by_time( &tsdb, from, from + window - 1, cb_count_tsl, &seen );
+  }
+
+  run.stats   = s_flash_0_timed.stats();
+  run.results = seen;
+
+  fdb_tsdb_deinit( &tsdb );
+  close_flash();
+
+  return ok;
+}
+
+/**
+ * @brief Emits one measured run as a JSON object
+ *
+ * @param out     Output stream
+ * @param name    Key for the object
+ * @param run     Data to emit
+ */
+static void print_run( FILE *out, const char *name, const CacheRun &run )
+{
+  fprintf( out,
+           "      \"%s\": { \"bus_reads\": %zu, \"bus_ms\": %.3f, \"cache_hits\": %zu, \"cache_misses\": %zu, "
+           "\"results\": %zu }",
+           name, run.stats.reads, run.stats.bus_us / 1000.0, run.stats.cache_hits, run.stats.cache_misses,
+           run.results );
+}
+
+/**
+ * @brief Emits the uncached and cached runs of one workload
+ *
+ * @param out       Output stream
+ * @param name      Key for the workload
+ * @param uncached  Run with the cache disabled
+ * @param cached    Run with the cache enabled
+ */
+static void print_workload( FILE *out, const char *name, const CacheRun &uncached, const CacheRun &cached )
+{
+  const double ratio = cached.stats.bus_us ? static_cast<double>( uncached.stats.bus_us ) / cached.stats.bus_us : 0.0;
+
+  fprintf( out, "    \"%s\": {\n", name );
+  print_run( out, "uncached", uncached );
+  fprintf( out, ",\n" );
+  print_run( out, "cached", cached );
+  fprintf( out, ",\n" );
+  fprintf( out, "      \"bus_time_ratio\": %.3f\n", ratio );
+  fprintf( out, "    }" );
+}
+
+/*-----------------------------------------------------------------------------
+Public Functions
+-----------------------------------------------------------------------------*/
+
+int main( int argc, char **argv )
+{
+  BenchConfig cfg;
+  if( !parse_args( argc, argv, cfg ) )
+  {
+    print_usage( argv[ 0 ] );
+    return -1;
+  }
+
+  /*---------------------------------------------------------------------------
+  Only the assert/atexit/logging plumbing is still mocked. Let it run freely.
+  ---------------------------------------------------------------------------*/
+  mock().ignoreOtherCalls();
+  fal_init();
+
+  /*---------------------------------------------------------------------------
+  Run each workload on identical flash contents, with and without the cache
+  ---------------------------------------------------------------------------*/
+  CacheRun kv_uncached   = {};
+  CacheRun kv_cached     = {};
+  CacheRun tsdb_uncached = {};
+  CacheRun tsdb_cached   = {};
+
+  bool ok = run_kv( cfg, 0, kv_uncached );
+  ok      = run_kv( cfg, cfg.cache_pages, kv_cached ) && ok;
+  ok      = run_tsdb( cfg, 0, tsdb_uncached ) && ok;
+  ok      = run_tsdb( cfg, cfg.cache_pages, tsdb_cached ) && ok;
+
+  /* The cache must never change what FlashDB reads back */
+  ok = ok && ( kv_uncached.results == kv_cached.results ) && ( tsdb_uncached.results == tsdb_cached.results );
+
+  /*---------------------------------------------------------------------------
+  Report
+  ---------------------------------------------------------------------------*/
+  FILE *out = cfg.output ? fopen( cfg.output, "w" ) : stdout;
+  if( !out )
+  {
+    fprintf( stderr, "Unable to open %s\n", cfg.output );
+    return -1;
+  }
+
+  fprintf( out, "{\n" );
+  fprintf( out,
+           "  \"config\": { \"cache_pages\": %zu, \"page_size\": %zu, \"keys\": %zu, \"updates\": %zu, "
+           "\"records\": %zu, \"queries\": %zu },\n",
+           cfg.cache_pages, cfg.page_size, cfg.keys, cfg.updates, cfg.records, cfg.queries );
+  fprintf( out, "  \"results\": {\n" );
+  print_workload( out, "kv", kv_uncached, kv_cached );
+  fprintf( out, ",\n" );
+  print_workload( out, "tsdb", tsdb_uncached, tsdb_cached );
+  fprintf( out, "\n  }\n}\n" );
+
+  if( out != stdout )
+  {
+    fclose( out );
+  }
+
+  return ok ? 0 : -1;
+}
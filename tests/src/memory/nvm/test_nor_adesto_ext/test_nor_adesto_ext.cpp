@@ -0,0 +1,332 @@
+/******************************************************************************
+ *  File Name:
+ *    test_nor_adesto_ext.cpp
+ *
+ *  Description:
+ *    Test cases for nor_adesto.cpp features that are not yet available in
+ *    the pinned mbedutils revision.
+ *
+ *  2024 | Brandon Braun | brandonbraun653@protonmail.com
+ *****************************************************************************/
+
+/*-----------------------------------------------------------------------------
+Includes
+-----------------------------------------------------------------------------*/
+#include <mbedutils/drivers/threading/thread.hpp>
+#include <mbedutils/drivers/memory/nvm/nor_flash.hpp>
+#include <mbedutils/drivers/memory/nvm/nor_flash_device.hpp>
+
+#include <CppUTest/CommandLineTestRunner.h>
+#include <CppUTest/TestHarness.h>
+#include "gpio_intf_expect.hpp"
+#include "spi_intf_expect.hpp"
+#include "time_intf_expect.hpp"
+
+using namespace mb::memory;
+using namespace mb::memory::nor;
+
+/*-----------------------------------------------------------------------------
+Constants
+-----------------------------------------------------------------------------*/
+
+static constexpr uint16_t at25sf_ready_flag = 0x0000;
+static constexpr uint16_t at25sf_busy_flag  = 0x0001;
+static constexpr uint16_t at25sf_sus_flag   = 0x8000;
+
+/*-----------------------------------------------------------------------------
+Tests
+-----------------------------------------------------------------------------*/
+
+int main( int argc, char **argv )
+{
+  return RUN_ALL_TESTS( argc, argv );
+}
+
+
+TEST_GROUP( nor_adesto )
+{
+  DeviceConfig      cfg;
+  device::PendStats pend_stats;
+  uint8_t           fake_status_register_byte1[ 8 ][ 3 ];
+  uint8_t           fake_status_register_byte2[ 8 ][ 3 ];
+
+  void setup()
+  {
+    memset( fake_status_register_byte1, 0, sizeof( fake_status_register_byte1 ) );
+    memset( fake_status_register_byte2, 0, sizeof( fake_status_register_byte2 ) );
+    memset( &cfg, 0, sizeof( cfg ) );
+    pend_stats = {};
+
+    cfg.dev_attr.block_size = 4096;
+    cfg.dev_attr.read_size  = 256;
+    cfg.dev_attr.write_size = 256;
+    cfg.dev_attr.size       = 0x1000000;
+    // cfg.dev_attr.start_addr = 0x00000000;
+    // cfg.dev_attr.end_addr   = 0x00FFFFFF;
+    cfg.dev_attr.erase_latency = 100;
+    // cfg.dev_attr.write_latency = 5;
+
+    mock().ignoreOtherCalls();
+  }
+
+  void teardown()
+  {
+    mock().checkExpectations();
+    mock().clear();
+  }
+
+  void setup_static_status_register_return_value( const int call_num, const DeviceConfig &cfg, const uint16_t ret_val )
+  {
+    /*-------------------------------------------------------------------------
+    Set the expectations for the transaction
+    -------------------------------------------------------------------------*/
+    expect::mb$::hw$::spi$::intf$::lock( 1, cfg.spi_port );
+    expect::mb$::hw$::spi$::intf$::unlock( 1, cfg.spi_port );
+    expect::mb$::hw$::gpio$::intf$::write( 2, cfg.spi_cs_port, cfg.spi_cs_pin, mb::hw::gpio::State_t::STATE_LOW );
+    expect::mb$::hw$::gpio$::intf$::write( 2, cfg.spi_cs_port, cfg.spi_cs_pin, mb::hw::gpio::State_t::STATE_HIGH );
+
+    /*-------------------------------------------------------------------------
+    Set the data to be returned for the status register read
+    -------------------------------------------------------------------------*/
+    fake_status_register_byte1[ call_num ][ 0 ] = 0x00;    // Dummy byte of the transfer
+    fake_status_register_byte1[ call_num ][ 1 ] = ret_val & 0xFF;
+
+    fake_status_register_byte2[ call_num ][ 0 ] = 0x00;    // Dummy byte of the transfer
+    fake_status_register_byte2[ call_num ][ 1 ] = ( ret_val >> 8 ) & 0xFF;
+
+    /* First call to transfer */
+    mock()
+        .expectOneCall( "mb::hw::spi::intf::transfer" )
+        .withParameter( "port", cfg.spi_port )
+        .withOutputParameterReturning( "rx", fake_status_register_byte1[ call_num ], 2 )
+        .withParameter( "length", 2 )
+        .ignoreOtherParameters();
+
+    /* Second call to transfer */
+    mock()
+        .expectOneCall( "mb::hw::spi::intf::transfer" )
+        .withParameter( "port", cfg.spi_port )
+        .withOutputParameterReturning( "rx", fake_status_register_byte2[ call_num ], 2 )
+        .withParameter( "length", 2 )
+        .ignoreOtherParameters();
+  }
+};
+
+
+TEST( nor_adesto, at25sfxxx_poll_event__unsupported_operation )
+{
+  CHECK( Status::ERR_NOT_SUPPORTED == device::adesto_at25sfxxx_poll_event( DeviceConfig(), Event::MEM_ERROR ) );
+}
+
+
+TEST( nor_adesto, at25sfxxx_poll_event__device_is_not_busy )
+{
+  /*---------------------------------------------------------------------------
+  Initialize
+  ---------------------------------------------------------------------------*/
+  this->setup_static_status_register_return_value( 0, cfg, at25sf_ready_flag );
+
+  /*---------------------------------------------------------------------------
+  Call FUT
+  ---------------------------------------------------------------------------*/
+  auto result = device::adesto_at25sfxxx_poll_event( cfg, Event::MEM_WRITE_COMPLETE );
+
+  /*---------------------------------------------------------------------------
+  Verify
+  ---------------------------------------------------------------------------*/
+  CHECK( result == Status::ERR_OK );
+}
+
+
+TEST( nor_adesto, at25sfxxx_poll_event__device_busy_does_not_block )
+{
+  /*---------------------------------------------------------------------------
+  Initialize
+  ---------------------------------------------------------------------------*/
+  mock().expectNoCall( "mb::time::delayMilliseconds" );
+  mock().expectNoCall( "mb::time::millis" );
+
+  this->setup_static_status_register_return_value( 0, cfg, at25sf_busy_flag );
+
+  /*---------------------------------------------------------------------------
+  Call FUT
+  ---------------------------------------------------------------------------*/
+  auto result = device::adesto_at25sfxxx_poll_event( cfg, Event::MEM_ERASE_COMPLETE );
+
+  /*---------------------------------------------------------------------------
+  Verify
+  ---------------------------------------------------------------------------*/
+  CHECK( result == Status::ERR_BUSY );
+}
+
+
+TEST( nor_adesto, at25sfxxx_pend_event__erase_suspended )
+{
+  /*---------------------------------------------------------------------------
+  Initialize
+  ---------------------------------------------------------------------------*/
+  expect::mb$::time$::millis( 1, 100 );    // Initializes start time
+  expect::mb$::time$::millis( 1, 100 );    // Cause a second iteration
+
+  mock().expectOneCall( "mb::time::delayMilliseconds" ).ignoreOtherParameters();
+
+  /* Still erasing, then suspended (SUS set, BUSY clear) */
+  this->setup_static_status_register_return_value( 0, cfg, at25sf_busy_flag );
+  this->setup_static_status_register_return_value( 1, cfg, at25sf_sus_flag );
+
+  /*---------------------------------------------------------------------------
+  Call FUT
+  ---------------------------------------------------------------------------*/
+  auto result = device::adesto_at25sfxxx_pend_event( cfg, Event::MEM_SUSPEND_COMPLETE, 1 );
+
+  /*---------------------------------------------------------------------------
+  Verify
+  ---------------------------------------------------------------------------*/
+  CHECK( result == Status::ERR_OK );
+}
+
+
+TEST( nor_adesto, at25sfxxx_pend_event__adaptive_first_sample_learns_expectation )
+{
+  /*---------------------------------------------------------------------------
+  Initialize
+  ---------------------------------------------------------------------------*/
+  cfg.pend_stats = &pend_stats;
+
+  /* No history yet, so fall back to polling once per millisecond */
+  expect::mb$::time$::micros( 1, 1000 );    // Start time
+  expect::mb$::time$::micros( 1, 1200 );    // Busy
+  expect::mb$::time$::micros( 1, 2500 );    // Ready
+
+  mock().expectOneCall( "mb::time::delayMilliseconds" ).withParameter( "val", 1 ).ignoreOtherParameters();
+
+  this->setup_static_status_register_return_value( 0, cfg, at25sf_busy_flag );
+  this->setup_static_status_register_return_value( 1, cfg, at25sf_ready_flag );
+
+  /*---------------------------------------------------------------------------
+  Call FUT
+  ---------------------------------------------------------------------------*/
+  auto result = device::adesto_at25sfxxx_pend_event( cfg, Event::MEM_WRITE_COMPLETE, 50 );
+
+  /*---------------------------------------------------------------------------
+  Verify
+  ---------------------------------------------------------------------------*/
+  CHECK( result == Status::ERR_OK );
+  CHECK_EQUAL( 1, pend_stats.event( Event::MEM_WRITE_COMPLETE ).samples );
+  CHECK_EQUAL( 1500, pend_stats.event( Event::MEM_WRITE_COMPLETE ).expected_us );
+  CHECK_EQUAL( 0, pend_stats.event( Event::MEM_ERASE_COMPLETE ).samples );
+}
+
+
+TEST( nor_adesto, at25sfxxx_pend_event__adaptive_sleeps_then_polls_finely )
+{
+  /*---------------------------------------------------------------------------
+  Initialize
+  ---------------------------------------------------------------------------*/
+  cfg.pend_stats = &pend_stats;
+  pend_stats.event( Event::MEM_ERASE_COMPLETE ).expected_us = 64000;
+  pend_stats.event( Event::MEM_ERASE_COMPLETE ).samples     = 4;
+
+  expect::mb$::time$::micros( 1, 0 );        // Start time
+  expect::mb$::time$::micros( 1, 56100 );    // Busy
+  expect::mb$::time$::micros( 1, 56150 );    // Busy
+  expect::mb$::time$::micros( 1, 56200 );    // Ready
+
+  /* One coarse sleep for 7/8 of the expected time, then back-to-back polls */
+  mock().expectOneCall( "mb::time::delayMilliseconds" ).withParameter( "val", 56 ).ignoreOtherParameters();
+
+  this->setup_static_status_register_return_value( 0, cfg, at25sf_busy_flag );
+  this->setup_static_status_register_return_value( 1, cfg, at25sf_busy_flag );
+  this->setup_static_status_register_return_value( 2, cfg, at25sf_ready_flag );
+
+  /*---------------------------------------------------------------------------
+  Call FUT
+  ---------------------------------------------------------------------------*/
+  auto result = device::adesto_at25sfxxx_pend_event( cfg, Event::MEM_ERASE_COMPLETE, 200 );
+
+  /*---------------------------------------------------------------------------
+  Verify
+  ---------------------------------------------------------------------------*/
+  auto &stats = pend_stats.event( Event::MEM_ERASE_COMPLETE );
+
+  CHECK( result == Status::ERR_OK );
+  CHECK_EQUAL( 5, stats.samples );
+  CHECK_EQUAL( 63025, stats.expected_us );    // 64000 + ( 56200 - 64000 ) / 8
+  CHECK_EQUAL( 50, stats.last_detect_us );    // Gap between the last busy poll and ready
+  CHECK_EQUAL( 50, stats.max_detect_us );
+}
+
+
+TEST( nor_adesto, at25sfxxx_pend_event__adaptive_overrun_sleeps_per_tick )
+{
+  /*---------------------------------------------------------------------------
+  Initialize
+  ---------------------------------------------------------------------------*/
+  cfg.pend_stats = &pend_stats;
+  pend_stats.event( Event::MEM_ERASE_COMPLETE ).expected_us = 8000;
+  pend_stats.event( Event::MEM_ERASE_COMPLETE ).samples     = 4;
+
+  expect::mb$::time$::micros( 1, 0 );        // Start time
+  expect::mb$::time$::micros( 1, 7100 );     // Busy, still inside the expected time
+  expect::mb$::time$::micros( 1, 8100 );     // Busy, overrun
+  expect::mb$::time$::micros( 1, 9200 );     // Busy, overrun
+  expect::mb$::time$::micros( 1, 10300 );    // Ready
+
+  /* Coarse sleep, one tight poll, then a tick per poll once past the expectation */
+  mock().expectOneCall( "mb::time::delayMilliseconds" ).withParameter( "val", 7 ).ignoreOtherParameters();
+  mock().expectNCalls( 2, "mb::time::delayMilliseconds" ).withParameter( "val", 1 ).ignoreOtherParameters();
+
+  this->setup_static_status_register_return_value( 0, cfg, at25sf_busy_flag );
+  this->setup_static_status_register_return_value( 1, cfg, at25sf_busy_flag );
+  this->setup_static_status_register_return_value( 2, cfg, at25sf_busy_flag );
+  this->setup_static_status_register_return_value( 3, cfg, at25sf_ready_flag );
+
+  /*---------------------------------------------------------------------------
+  Call FUT
+  ---------------------------------------------------------------------------*/
+  auto result = device::adesto_at25sfxxx_pend_event( cfg, Event::MEM_ERASE_COMPLETE, 200 );
+
+  /*---------------------------------------------------------------------------
+  Verify
+  ---------------------------------------------------------------------------*/
+  auto &stats = pend_stats.event( Event::MEM_ERASE_COMPLETE );
+
+  CHECK( result == Status::ERR_OK );
+  CHECK_EQUAL( 5, stats.samples );
+  CHECK_EQUAL( 8287, stats.expected_us );       // 8000 + ( 10300 - 8000 ) / 8
+  CHECK_EQUAL( 1100, stats.last_detect_us );    // One tick late at worst
+  CHECK_EQUAL( 1100, stats.max_detect_us );
+}
+
+
+TEST( nor_adesto, at25sfxxx_pend_event__adaptive_timeout_is_not_learned )
+{
+  /*---------------------------------------------------------------------------
+  Initialize
+  ---------------------------------------------------------------------------*/
+  cfg.pend_stats = &pend_stats;
+  pend_stats.event( Event::MEM_WRITE_COMPLETE ).expected_us = 800;
+  pend_stats.event( Event::MEM_WRITE_COMPLETE ).samples     = 10;
+
+  expect::mb$::time$::micros( 1, 0 );       // Start time
+  expect::mb$::time$::micros( 1, 3000 );    // Busy, overrun
+  expect::mb$::time$::micros( 1, 6000 );    // Busy, past the 5ms timeout
+
+  /* Expected time is under a tick, so no coarse sleep, only a tick per overrun poll */
+  mock().expectOneCall( "mb::time::delayMilliseconds" ).withParameter( "val", 1 ).ignoreOtherParameters();
+
+  this->setup_static_status_register_return_value( 0, cfg, at25sf_busy_flag );
+  this->setup_static_status_register_return_value( 1, cfg, at25sf_busy_flag );
+
+  /*---------------------------------------------------------------------------
+  Call FUT
+  ---------------------------------------------------------------------------*/
+  auto result = device::adesto_at25sfxxx_pend_event( cfg, Event::MEM_WRITE_COMPLETE, 5 );
+
+  /*---------------------------------------------------------------------------
+  Verify
+  ---------------------------------------------------------------------------*/
+  CHECK( result == Status::ERR_TIMEOUT );
+  CHECK_EQUAL( 10, pend_stats.event( Event::MEM_WRITE_COMPLETE ).samples );
+  CHECK_EQUAL( 800, pend_stats.event( Event::MEM_WRITE_COMPLETE ).expected_us );
+}
@@ -25,38 +25,20 @@ Includes
 #include "mutex_intf_expect.hpp"
 #include "nor_flash_device_expect.hpp"
 
+#include <tests/harness/nor_device_config_comparator.hpp>
+
 using namespace mb::hw;
 using namespace mb::memory;
 using namespace mb::memory::nor;
 using namespace CppUMockGen;
 
-
-class DeviceConfigComparator : public MockNamedValueComparator
-{
-public:
-  bool isEqual( const void *object1, const void *object2 ) override
-  {
-    const mb::memory::nor::DeviceConfig *config1 = static_cast<const mb::memory::nor::DeviceConfig *>( object1 );
-    const mb::memory::nor::DeviceConfig *config2 = static_cast<const mb::memory::nor::DeviceConfig *>( object2 );
-    // Implement your comparison logic here
-    return 0 == memcmp( config1, config2, sizeof( mb::memory::nor::DeviceConfig ) );
-  }
-
-  SimpleString valueToString( const void *object ) override
-  {
-    const mb::memory::nor::DeviceConfig *config = static_cast<const mb::memory::nor::DeviceConfig *>( object );
-    // Implement your logic to convert DeviceConfig to string
-    return SimpleString( "DeviceConfig" );
-  }
-};
-
 /*-----------------------------------------------------------------------------
 Tests
 -----------------------------------------------------------------------------*/
 
 int main( int argc, char **argv )
 {
-  DeviceConfigComparator comparator;
+  TestHarness::DeviceConfigComparator comparator;
   mock().installComparator( "mb::memory::nor::DeviceConfig", comparator );
 
   return RUN_ALL_TESTS( argc, argv );
@@ -0,0 +1,1448 @@
+/******************************************************************************
+ *  File Name:
+ *    test_nor_flash_ext.cpp
+ *
+ *  Description:
+ *    Test cases for nor_flash.cpp features that are not yet available in
+ *    the pinned mbedutils revision.
+ *
+ *  2024 | Brandon Braun | brandonbraun653@protonmail.com
+ *****************************************************************************/
+
+/*-----------------------------------------------------------------------------
+Includes
+-----------------------------------------------------------------------------*/
+
+#include <mbedutils/drivers/memory/nvm/jedec_cfi_cmds.hpp>
+#include <mbedutils/drivers/memory/nvm/nor_flash.hpp>
+#include <mbedutils/drivers/memory/nvm/nor_flash_device.hpp>
+#include <mbedutils/drivers/threading/thread.hpp>
+
+#include <CppUTest/TestHarness.h>
+#include <CppUTest/CommandLineTestRunner.h>
+#include "assert_expect.hpp"
+#include "gpio_intf_expect.hpp"
+#include "spi_intf_expect.hpp"
+#include "time_intf_expect.hpp"
+#include "mutex_intf_expect.hpp"
+#include "nor_flash_device_expect.hpp"
+
+#include <tests/harness/nor_device_config_comparator.hpp>
+
+using namespace mb::hw;
+using namespace mb::memory;
+using namespace mb::memory::nor;
+using namespace CppUMockGen;
+
+/*-----------------------------------------------------------------------------
+Static Data
+-----------------------------------------------------------------------------*/
+
+static size_t s_async_calls;
+static Event  s_async_event;
+static Status s_async_status;
+
+/*-----------------------------------------------------------------------------
+Static Functions
+-----------------------------------------------------------------------------*/
+
+/**
+ * @brief Records the result of an asynchronous operation
+ */
+static void cb_async_complete( const Event event, const Status status )
+{
+  s_async_calls++;
+  s_async_event  = event;
+  s_async_status = status;
+}
+
+/*-----------------------------------------------------------------------------
+Public Functions
+-----------------------------------------------------------------------------*/
+
+int main( int argc, char **argv )
+{
+  TestHarness::DeviceConfigComparator comparator;
+  mock().installComparator( "mb::memory::nor::DeviceConfig", comparator );
+
+  return RUN_ALL_TESTS( argc, argv );
+}
+
+/*-----------------------------------------------------------------------------
+Fixtures
+-----------------------------------------------------------------------------*/
+
+/**
+ * @brief Driver, configuration and bus expectations shared by every feature
+ * group. Groups that need a different configuration override setup() and
+ * adjust cfg between init_config() and open_driver().
+ */
+class NorFlashFixture : public Utest
+{
+public:
+  DeviceDriver *norDriver;
+  DeviceConfig  cfg;
+  uint32_t      input_data;
+  uint32_t      output_data;
+
+  void setup() override
+  {
+    init_config();
+    open_driver();
+  }
+
+  void teardown() override
+  {
+    norDriver->close();
+    delete norDriver;
+    mock().checkExpectations();
+    mock().clear();
+  }
+
+  void init_config()
+  {
+    mock().ignoreOtherCalls();
+
+    /*-------------------------------------------------------------------------
+    Initialize the device configuration
+    -------------------------------------------------------------------------*/
+    memset( &cfg, 0, sizeof( cfg ) );
+
+    cfg.dev_attr.block_size         = 4096;
+    cfg.dev_attr.read_size          = 256;
+    cfg.dev_attr.write_size         = 256;
+    cfg.dev_attr.erase_size         = 4096;
+    cfg.dev_attr.size               = 0x1000000;
+    cfg.dev_attr.erase_latency      = 100;
+    cfg.dev_attr.erase_chip_latency = 10000;
+    cfg.dev_attr.write_latency      = 5;
+    cfg.pend_event_cb               = device::adesto_at25sfxxx_pend_event;
+
+    /*-------------------------------------------------------------------------
+    Initialize the input/output_data buffers
+    -------------------------------------------------------------------------*/
+    input_data  = 0;
+    output_data = 0;
+  }
+
+  void open_driver()
+  {
+    norDriver = new DeviceDriver();
+    norDriver->open( cfg );
+  }
+
+  void expect_write_enable( const DeviceConfig &cfg )
+  {
+    using namespace mb::hw;
+    using namespace mb::memory;
+
+    /*-------------------------------------------------------------------------
+    Set the expectations for "issue_write_enable"
+    -------------------------------------------------------------------------*/
+    expect::mb$::hw$::gpio$::intf$::write( 1, cfg.spi_cs_port, cfg.spi_cs_pin, gpio::State_t::STATE_LOW );
+    expect::mb$::hw$::spi$::intf$::write( 1, cfg.spi_port, IgnoreParameter(),
+                                          static_cast<size_t>( cfi::WRITE_ENABLE_OPS_LEN ) );
+    expect::mb$::hw$::gpio$::intf$::write( 1, cfg.spi_cs_port, cfg.spi_cs_pin, gpio::State_t::STATE_HIGH );
+  }
+
+  void expect_page_program( const DeviceConfig &cfg, const void *data, const size_t size, const Status pend_result )
+  {
+    using namespace mb::hw;
+    using namespace mb::memory;
+
+    /*-------------------------------------------------------------------------
+    Set the expectations for a single page program while the bus is held
+    -------------------------------------------------------------------------*/
+    this->expect_write_enable( cfg );
+    expect::mb$::hw$::gpio$::intf$::write( 1, cfg.spi_cs_port, cfg.spi_cs_pin, gpio::State_t::STATE_LOW );
+    expect::mb$::hw$::spi$::intf$::write( 1, cfg.spi_port, IgnoreParameter(), static_cast<size_t>( cfi::PAGE_PROGRAM_OPS_LEN ) );
+    expect::mb$::hw$::spi$::intf$::write( 1, cfg.spi_port, data, size );
+    expect::mb$::hw$::gpio$::intf$::write( 1, cfg.spi_cs_port, cfg.spi_cs_pin, gpio::State_t::STATE_HIGH );
+    expect::mb$::memory$::nor$::device$::adesto_at25sfxxx_pend_event( IgnoreParameter(), Event::MEM_WRITE_COMPLETE,
+                                                                      cfg.dev_attr.write_latency, pend_result );
+  }
+
+  void expect_erase( const size_t ops_len, const size_t latency )
+  {
+    using namespace mb::hw;
+
+    expect::mb$::hw$::spi$::intf$::lock( cfg.spi_port );
+    this->expect_write_enable( cfg );
+    expect::mb$::hw$::gpio$::intf$::write( 1, cfg.spi_cs_port, cfg.spi_cs_pin, gpio::State_t::STATE_LOW );
+    expect::mb$::hw$::spi$::intf$::write( 1, cfg.spi_port, IgnoreParameter(), ops_len );
+    expect::mb$::hw$::gpio$::intf$::write( 1, cfg.spi_cs_port, cfg.spi_cs_pin, gpio::State_t::STATE_HIGH );
+    expect::mb$::hw$::spi$::intf$::unlock( cfg.spi_port );
+    expect::mb$::memory$::nor$::device$::adesto_at25sfxxx_pend_event( IgnoreParameter(), Event::MEM_ERASE_COMPLETE, latency,
+                                                                      Status::ERR_OK );
+  }
+};
+
+/**
+ * @brief Configuration for groups that complete operations through process()
+ */
+class NorFlashAsyncFixture : public NorFlashFixture
+{
+public:
+  void setup() override
+  {
+    init_config();
+    cfg.poll_event_cb = device::adesto_at25sfxxx_poll_event;
+
+    s_async_calls  = 0;
+    s_async_event  = Event::MEM_ERROR;
+    s_async_status = Status::ERR_OK;
+
+    open_driver();
+  }
+};
+
+/*-----------------------------------------------------------------------------
+Test Case: Streaming writes
+-----------------------------------------------------------------------------*/
+
+TEST_GROUP_BASE( nor_flash_write_stream, NorFlashFixture )
+{
+};
+
+TEST( nor_flash_write_stream, bad_arguments )
+{
+  /*---------------------------------------------------------------------------
+  Initialize
+  ---------------------------------------------------------------------------*/
+  Status result;
+  mock().expectNoCall( "mb::hw::spi::intf::lock" );
+
+  /*---------------------------------------------------------------------------
+  Test
+  ---------------------------------------------------------------------------*/
+
+  /* No data */
+  result = norDriver->writeStream( 0, nullptr, 55 );
+  CHECK_EQUAL( Status::ERR_BAD_ARG, result );
+
+  /* No length */
+  result = norDriver->writeStream( 0, &input_data, 0 );
+  CHECK_EQUAL( Status::ERR_BAD_ARG, result );
+
+  /* Runs off the end of the device */
+  result = norDriver->writeStream( cfg.dev_attr.size - 2, &input_data, sizeof( input_data ) );
+  CHECK_EQUAL( Status::ERR_BAD_ARG, result );
+
+  /* Not open */
+  norDriver->close();
+  result = norDriver->writeStream( 0, &input_data, sizeof( input_data ) );
+  CHECK_EQUAL( Status::ERR_BAD_STATE, result );
+}
+
+TEST( nor_flash_write_stream, single_aligned_page )
+{
+  /*---------------------------------------------------------------------------
+  Initialize
+  ---------------------------------------------------------------------------*/
+  Status  result;
+  uint8_t data[ 256 ];
+
+  expect::mb$::hw$::spi$::intf$::lock( cfg.spi_port );
+  this->expect_page_program( cfg, data, sizeof( data ), Status::ERR_OK );
+  expect::mb$::hw$::spi$::intf$::unlock( cfg.spi_port );
+
+  /*---------------------------------------------------------------------------
+  Test
+  ---------------------------------------------------------------------------*/
+  result = norDriver->writeStream( 0x2000, data, sizeof( data ) );
+  CHECK_EQUAL( Status::ERR_OK, result );
+}
+
+TEST( nor_flash_write_stream, splits_on_page_boundaries )
+{
+  /*---------------------------------------------------------------------------
+  Initialize
+  ---------------------------------------------------------------------------*/
+  Status  result;
+  uint8_t data[ 300 ];
+
+  /*---------------------------------------------------------------------------
+  0x10F0 leaves 16 bytes in its page, then one full page, then the 28 byte
+  remainder. The bus is locked once for all three programs.
+  ---------------------------------------------------------------------------*/
+  expect::mb$::hw$::spi$::intf$::lock( cfg.spi_port );
+  this->expect_page_program( cfg, &data[ 0 ], 16, Status::ERR_OK );
+  this->expect_page_program( cfg, &data[ 16 ], 256, Status::ERR_OK );
+  this->expect_page_program( cfg, &data[ 272 ], 28, Status::ERR_OK );
+  expect::mb$::hw$::spi$::intf$::unlock( cfg.spi_port );
+
+  /*---------------------------------------------------------------------------
+  Test
+  ---------------------------------------------------------------------------*/
+  result = norDriver->writeStream( 0x10F0, data, sizeof( data ) );
+  CHECK_EQUAL( Status::ERR_OK, result );
+}
+
+TEST( nor_flash_write_stream, stops_on_program_failure )
+{
+  /*---------------------------------------------------------------------------
+  Initialize
+  ---------------------------------------------------------------------------*/
+  Status  result;
+  uint8_t data[ 600 ];
+
+  /*---------------------------------------------------------------------------
+  The second page times out. Nothing after it is programmed and the bus is
+  still released.
+  ---------------------------------------------------------------------------*/
+  expect::mb$::hw$::spi$::intf$::lock( cfg.spi_port );
+  this->expect_page_program( cfg, &data[ 0 ], 256, Status::ERR_OK );
+  this->expect_page_program( cfg, &data[ 256 ], 256, Status::ERR_TIMEOUT );
+  expect::mb$::hw$::spi$::intf$::unlock( cfg.spi_port );
+
+  /*---------------------------------------------------------------------------
+  Test
+  ---------------------------------------------------------------------------*/
+  result = norDriver->writeStream( 0x4000, data, sizeof( data ) );
+  CHECK_EQUAL( Status::ERR_TIMEOUT, result );
+}
+
+/*-----------------------------------------------------------------------------
+Test Case: Asynchronous write and erase
+-----------------------------------------------------------------------------*/
+
+TEST_GROUP_BASE( nor_flash_async, NorFlashAsyncFixture )
+{
+  void start_async_write( const uint64_t address, const size_t start_ms )
+  {
+    using namespace mb::hw;
+
+    /*-------------------------------------------------------------------------
+    Issue the program command without waiting for it to finish
+    -------------------------------------------------------------------------*/
+    expect::mb$::hw$::spi$::intf$::lock( cfg.spi_port );
+    this->expect_write_enable( cfg );
+    expect::mb$::hw$::gpio$::intf$::write( 1, cfg.spi_cs_port, cfg.spi_cs_pin, gpio::State_t::STATE_LOW );
+    expect::mb$::hw$::spi$::intf$::write( 1, cfg.spi_port, IgnoreParameter(), static_cast<size_t>( cfi::PAGE_PROGRAM_OPS_LEN ) );
+    expect::mb$::hw$::spi$::intf$::write( 1, cfg.spi_port, &input_data, sizeof( input_data ) );
+    expect::mb$::hw$::gpio$::intf$::write( 1, cfg.spi_cs_port, cfg.spi_cs_pin, gpio::State_t::STATE_HIGH );
+    expect::mb$::hw$::spi$::intf$::unlock( cfg.spi_port );
+    expect::mb$::time$::millis( start_ms );
+
+    auto cb = CompletionCallback::create<cb_async_complete>();
+    CHECK_EQUAL( Status::ERR_OK, norDriver->writeAsync( address, &input_data, sizeof( input_data ), cb ) );
+  }
+};
+
+TEST( nor_flash_async, bad_arguments )
+{
+  /*---------------------------------------------------------------------------
+  Initialize
+  ---------------------------------------------------------------------------*/
+  Status result;
+  auto   cb = CompletionCallback::create<cb_async_complete>();
+  mock().expectNoCall( "mb::hw::spi::intf::lock" );
+
+  /*---------------------------------------------------------------------------
+  Test
+  ---------------------------------------------------------------------------*/
+
+  /* No data */
+  result = norDriver->writeAsync( 0, nullptr, 55, cb );
+  CHECK_EQUAL( Status::ERR_BAD_ARG, result );
+
+  /* Size bigger than page */
+  result = norDriver->writeAsync( 0, &input_data, 257, cb );
+  CHECK_EQUAL( Status::ERR_BAD_ARG, result );
+
+  /* Erase block out of range: the first index past the last block */
+  result = norDriver->eraseAsync( cfg.dev_attr.size / cfg.dev_attr.erase_size, cb );
+  CHECK_EQUAL( Status::ERR_BAD_ARG, result );
+
+  /* Device can't be polled without blocking */
+  norDriver->close();
+  cfg.poll_event_cb = nullptr;
+  norDriver->open( cfg );
+
+  result = norDriver->writeAsync( 0, &input_data, sizeof( input_data ), cb );
+  CHECK_EQUAL( Status::ERR_NOT_SUPPORTED, result );
+
+  CHECK_EQUAL( 0, s_async_calls );
+}
+
+TEST( nor_flash_async, write_async_returns_before_completion )
+{
+  /*---------------------------------------------------------------------------
+  Initialize
+  ---------------------------------------------------------------------------*/
+  mock().expectNoCall( "mb::memory::nor::device::adesto_at25sfxxx_pend_event" );
+
+  /*---------------------------------------------------------------------------
+  Test
+  ---------------------------------------------------------------------------*/
+  this->start_async_write( 0x1000, 100 );
+
+  CHECK( norDriver->isBusy() );
+  CHECK_EQUAL( 0, s_async_calls );
+}
+
+TEST( nor_flash_async, write_async_completes_from_process )
+{
+  /*---------------------------------------------------------------------------
+  Initialize
+  ---------------------------------------------------------------------------*/
+  this->start_async_write( 0x1000, 100 );
+
+  /*---------------------------------------------------------------------------
+  Test Case: Still programming
+  ---------------------------------------------------------------------------*/
+  expect::mb$::memory$::nor$::device$::adesto_at25sfxxx_poll_event( IgnoreParameter(), Event::MEM_WRITE_COMPLETE, Status::ERR_BUSY );
+  expect::mb$::time$::millis( 102 );
+
+  norDriver->process();
+  CHECK( norDriver->isBusy() );
+  CHECK_EQUAL( 0, s_async_calls );
+
+  /*---------------------------------------------------------------------------
+  Test Case: Program finished, callback fires exactly once
+  ---------------------------------------------------------------------------*/
+  expect::mb$::memory$::nor$::device$::adesto_at25sfxxx_poll_event( IgnoreParameter(), Event::MEM_WRITE_COMPLETE, Status::ERR_OK );
+
+  norDriver->process();
+  CHECK_FALSE( norDriver->isBusy() );
+  CHECK_EQUAL( 1, s_async_calls );
+  CHECK( s_async_event == Event::MEM_WRITE_COMPLETE );
+  CHECK_EQUAL( Status::ERR_OK, s_async_status );
+
+  /*---------------------------------------------------------------------------
+  Test Case: Idle driver doesn't touch the device
+  ---------------------------------------------------------------------------*/
+  mock().expectNoCall( "mb::memory::nor::device::adesto_at25sfxxx_poll_event" );
+  norDriver->process();
+  CHECK_EQUAL( 1, s_async_calls );
+}
+
+TEST( nor_flash_async, busy_driver_rejects_new_operations )
+{
+  /*---------------------------------------------------------------------------
+  Initialize
+  ---------------------------------------------------------------------------*/
+  auto cb = CompletionCallback::create<cb_async_complete>();
+  this->start_async_write( 0x1000, 100 );
+
+  /*---------------------------------------------------------------------------
+  Test
+  ---------------------------------------------------------------------------*/
+  mock().expectNoCall( "mb::hw::spi::intf::lock" );
+
+  CHECK_EQUAL( Status::ERR_BUSY, norDriver->write( 0x2000, &input_data, sizeof( input_data ) ) );
+  CHECK_EQUAL( Status::ERR_BUSY, norDriver->read( 0x2000, &output_data, sizeof( output_data ) ) );
+  CHECK_EQUAL( Status::ERR_BUSY, norDriver->erase( 1 ) );
+  CHECK_EQUAL( Status::ERR_BUSY, norDriver->writeAsync( 0x2000, &input_data, sizeof( input_data ), cb ) );
+  CHECK_EQUAL( Status::ERR_BUSY, norDriver->eraseAsync( 1, cb ) );
+}
+
+TEST( nor_flash_async, erase_async_times_out )
+{
+  using namespace mb::hw;
+
+  /*---------------------------------------------------------------------------
+  Initialize
+  ---------------------------------------------------------------------------*/
+  auto cb = CompletionCallback::create<cb_async_complete>();
+
+  expect::mb$::hw$::spi$::intf$::lock( cfg.spi_port );
+  this->expect_write_enable( cfg );
+  expect::mb$::hw$::gpio$::intf$::write( 1, cfg.spi_cs_port, cfg.spi_cs_pin, gpio::State_t::STATE_LOW );
+  expect::mb$::hw$::spi$::intf$::write( 1, cfg.spi_port, IgnoreParameter(), static_cast<size_t>( cfi::BLOCK_ERASE_OPS_LEN ) );
+  expect::mb$::hw$::gpio$::intf$::write( 1, cfg.spi_cs_port, cfg.spi_cs_pin, gpio::State_t::STATE_HIGH );
+  expect::mb$::hw$::spi$::intf$::unlock( cfg.spi_port );
+  expect::mb$::time$::millis( 1000 );
+
+  CHECK_EQUAL( Status::ERR_OK, norDriver->eraseAsync( 0, cb ) );
+
+  /*---------------------------------------------------------------------------
+  Test Case: Device stays busy past the erase latency
+  ---------------------------------------------------------------------------*/
+  expect::mb$::memory$::nor$::device$::adesto_at25sfxxx_poll_event( IgnoreParameter(), Event::MEM_ERASE_COMPLETE, Status::ERR_BUSY );
+  expect::mb$::time$::millis( 1000 + cfg.dev_attr.erase_latency + 1 );
+
+  norDriver->process();
+  CHECK_FALSE( norDriver->isBusy() );
+  CHECK_EQUAL( 1, s_async_calls );
+  CHECK( s_async_event == Event::MEM_ERASE_COMPLETE );
+  CHECK_EQUAL( Status::ERR_TIMEOUT, s_async_status );
+}
+
+/*-----------------------------------------------------------------------------
+Test Case: Read cache
+-----------------------------------------------------------------------------*/
+
+TEST_GROUP_BASE( nor_flash_read_cache, NorFlashFixture )
+{
+  CachePage cache_pages[ 2 ];
+  uint8_t   cache_data[ 2 ][ 256 ];
+  uint8_t   page_a[ 256 ];
+  uint8_t   page_b[ 256 ];
+  uint8_t   page_c[ 256 ];
+
+  void setup() override
+  {
+    NorFlashFixture::setup();
+
+    for( size_t i = 0; i < sizeof( page_a ); i++ )
+    {
+      page_a[ i ] = static_cast<uint8_t>( i );
+      page_b[ i ] = static_cast<uint8_t>( ~i );
+      page_c[ i ] = static_cast<uint8_t>( i ^ 0x5A );
+    }
+  }
+
+  void enable_read_cache()
+  {
+    norDriver->close();
+
+    cfg.read_cache.pages     = cache_pages;
+    cfg.read_cache.data      = &cache_data[ 0 ][ 0 ];
+    cfg.read_cache.num_pages = 2;
+
+    norDriver->open( cfg );
+  }
+
+  void expect_page_read( const uint8_t *contents )
+  {
+    using namespace mb::hw;
+
+    /*-------------------------------------------------------------------------
+    A cache miss always fetches the whole read_size page
+    -------------------------------------------------------------------------*/
+    expect::mb$::hw$::spi$::intf$::lock( cfg.spi_port );
+    expect::mb$::hw$::gpio$::intf$::write( 1, cfg.spi_cs_port, cfg.spi_cs_pin, gpio::State_t::STATE_LOW );
+    expect::mb$::hw$::spi$::intf$::write( 1, cfg.spi_port, IgnoreParameter(), static_cast<size_t>( cfi::READ_ARRAY_HS_OPS_LEN ) );
+    mock()
+        .expectOneCall( "mb::hw::spi::intf::read" )
+        .withParameter( "port", cfg.spi_port )
+        .withOutputParameterReturning( "data", contents, cfg.dev_attr.read_size )
+        .withParameter( "length", cfg.dev_attr.read_size )
+        .ignoreOtherParameters();
+    expect::mb$::hw$::gpio$::intf$::write( 1, cfg.spi_cs_port, cfg.spi_cs_pin, gpio::State_t::STATE_HIGH );
+    expect::mb$::hw$::spi$::intf$::unlock( cfg.spi_port );
+  }
+};
+
+TEST( nor_flash_read_cache, disabled_by_default )
+{
+  /*---------------------------------------------------------------------------
+  Test Case: Every read goes to the device and nothing is counted
+  ---------------------------------------------------------------------------*/
+  mock().expectNCalls( 2, "mb::hw::spi::intf::lock" ).ignoreOtherParameters();
+
+  CHECK_EQUAL( Status::ERR_OK, norDriver->read( 0x1000, &output_data, sizeof( output_data ) ) );
+  CHECK_EQUAL( Status::ERR_OK, norDriver->read( 0x1000, &output_data, sizeof( output_data ) ) );
+
+  CHECK_EQUAL( 0, norDriver->stats().cache_hits );
+  CHECK_EQUAL( 0, norDriver->stats().cache_misses );
+}
+
+TEST( nor_flash_read_cache, bad_config )
+{
+  /*---------------------------------------------------------------------------
+  Test Case: Page descriptors without page storage
+  ---------------------------------------------------------------------------*/
+  norDriver->close();
+  mock().clear();
+  mock().ignoreOtherCalls();
+
+  cfg.read_cache.pages     = cache_pages;
+  cfg.read_cache.data      = nullptr;
+  cfg.read_cache.num_pages = 2;
+
+  expect::mb$::assert$::format_and_log_assert_failure(
+    false, IgnoreParameter(), IgnoreParameter(), IgnoreParameter(),
+   "Unable to open NOR device, invalid state", false
+   );
+
+  norDriver->open( cfg );
+}
+
+TEST( nor_flash_read_cache, hit_after_miss )
+{
+  this->enable_read_cache();
+
+  /*---------------------------------------------------------------------------
+  Test Case: First access loads the page
+  ---------------------------------------------------------------------------*/
+  this->expect_page_read( page_a );
+
+  CHECK_EQUAL( Status::ERR_OK, norDriver->read( 0x1004, &output_data, sizeof( output_data ) ) );
+  MEMCMP_EQUAL( &page_a[ 4 ], &output_data, sizeof( output_data ) );
+  CHECK_EQUAL( 1, norDriver->stats().cache_misses );
+
+  /*---------------------------------------------------------------------------
+  Test Case: Anywhere else in the page is served from RAM
+  ---------------------------------------------------------------------------*/
+  mock().expectNoCall( "mb::hw::spi::intf::lock" );
+
+  CHECK_EQUAL( Status::ERR_OK, norDriver->read( 0x10F0, &output_data, sizeof( output_data ) ) );
+  MEMCMP_EQUAL( &page_a[ 0xF0 ], &output_data, sizeof( output_data ) );
+  CHECK_EQUAL( 1, norDriver->stats().cache_hits );
+  CHECK_EQUAL( 1, norDriver->stats().cache_misses );
+}
+
+TEST( nor_flash_read_cache, spans_pages )
+{
+  uint8_t readback[ 8 ];
+  this->enable_read_cache();
+
+  /*---------------------------------------------------------------------------
+  Test Case: A read across a page boundary fills both pages
+  ---------------------------------------------------------------------------*/
+  this->expect_page_read( page_a );
+  this->expect_page_read( page_b );
+
+  CHECK_EQUAL( Status::ERR_OK, norDriver->read( 0x10FC, readback, sizeof( readback ) ) );
+  MEMCMP_EQUAL( &page_a[ 0xFC ], &readback[ 0 ], 4 );
+  MEMCMP_EQUAL( &page_b[ 0 ], &readback[ 4 ], 4 );
+  CHECK_EQUAL( 2, norDriver->stats().cache_misses );
+}
+
+TEST( nor_flash_read_cache, evicts_least_recently_used )
+{
+  this->enable_read_cache();
+
+  this->expect_page_read( page_a );
+  this->expect_page_read( page_b );
+  norDriver->read( 0x1000, &output_data, sizeof( output_data ) );
+  norDriver->read( 0x2000, &output_data, sizeof( output_data ) );
+
+  /* Touch A so that B becomes the oldest page */
+  norDriver->read( 0x1000, &output_data, sizeof( output_data ) );
+
+  /*---------------------------------------------------------------------------
+  Test Case: Loading C replaces B, not A
+  ---------------------------------------------------------------------------*/
+  this->expect_page_read( page_c );
+  norDriver->read( 0x3000, &output_data, sizeof( output_data ) );
+  CHECK_EQUAL( 1, norDriver->stats().cache_evictions );
+
+  norDriver->read( 0x1000, &output_data, sizeof( output_data ) );
+  MEMCMP_EQUAL( &page_a[ 0 ], &output_data, sizeof( output_data ) );
+  CHECK_EQUAL( 2, norDriver->stats().cache_hits );
+
+  this->expect_page_read( page_b );
+  norDriver->read( 0x2000, &output_data, sizeof( output_data ) );
+  CHECK_EQUAL( 4, norDriver->stats().cache_misses );
+  CHECK_EQUAL( 2, norDriver->stats().cache_evictions );
+}
+
+TEST( nor_flash_read_cache, invalidated_by_write )
+{
+  this->enable_read_cache();
+
+  this->expect_page_read( page_a );
+  norDriver->read( 0x1000, &output_data, sizeof( output_data ) );
+
+  input_data = 0x12345678;
+  expect::mb$::hw$::spi$::intf$::lock( cfg.spi_port );
+  this->expect_page_program( cfg, &input_data, sizeof( input_data ), Status::ERR_OK );
+  expect::mb$::hw$::spi$::intf$::unlock( cfg.spi_port );
+  CHECK_EQUAL( Status::ERR_OK, norDriver->write( 0x1010, &input_data, sizeof( input_data ) ) );
+
+  /*---------------------------------------------------------------------------
+  Test Case: The programmed page is fetched again
+  ---------------------------------------------------------------------------*/
+  this->expect_page_read( page_b );
+  norDriver->read( 0x1000, &output_data, sizeof( output_data ) );
+  MEMCMP_EQUAL( &page_b[ 0 ], &output_data, sizeof( output_data ) );
+  CHECK_EQUAL( 2, norDriver->stats().cache_misses );
+  CHECK_EQUAL( 0, norDriver->stats().cache_hits );
+}
+
+TEST( nor_flash_read_cache, invalidated_by_erase )
+{
+  this->enable_read_cache();
+
+  this->expect_page_read( page_a );
+  this->expect_page_read( page_b );
+  norDriver->read( 0x0000, &output_data, sizeof( output_data ) );
+  norDriver->read( 0x1000, &output_data, sizeof( output_data ) );
+
+  /*---------------------------------------------------------------------------
+  Test Case: Erasing block 0 only drops pages inside it
+  ---------------------------------------------------------------------------*/
+  this->expect_erase( cfi::BLOCK_ERASE_OPS_LEN, cfg.dev_attr.erase_latency );
+  CHECK_EQUAL( Status::ERR_OK, norDriver->erase( 0 ) );
+
+  this->expect_page_read( page_c );
+  norDriver->read( 0x0000, &output_data, sizeof( output_data ) );
+  MEMCMP_EQUAL( &page_c[ 0 ], &output_data, sizeof( output_data ) );
+
+  norDriver->read( 0x1000, &output_data, sizeof( output_data ) );
+  MEMCMP_EQUAL( &page_b[ 0 ], &output_data, sizeof( output_data ) );
+  CHECK_EQUAL( 1, norDriver->stats().cache_hits );
+
+  /*---------------------------------------------------------------------------
+  Test Case: Chip erase drops everything
+  ---------------------------------------------------------------------------*/
+  this->expect_erase( cfi::CHIP_ERASE_OPS_LEN, cfg.dev_attr.erase_chip_latency );
+  CHECK_EQUAL( Status::ERR_OK, norDriver->erase() );
+
+  this->expect_page_read( page_a );
+  norDriver->read( 0x1000, &output_data, sizeof( output_data ) );
+  CHECK_EQUAL( 4, norDriver->stats().cache_misses );
+}
+
+/*-----------------------------------------------------------------------------
+Test Case: Write combining
+-----------------------------------------------------------------------------*/
+
+TEST_GROUP_BASE( nor_flash_write_combining, NorFlashFixture )
+{
+  uint8_t write_buffer[ 256 ];
+
+  void enable_write_combining()
+  {
+    norDriver->close();
+
+    memset( write_buffer, 0, sizeof( write_buffer ) );
+    cfg.write_buffer = write_buffer;
+
+    norDriver->open( cfg );
+  }
+};
+
+TEST( nor_flash_write_combining, defers_small_writes )
+{
+  const uint32_t values[ 3 ] = { 0x11111111, 0x22222222, 0x33333333 };
+  this->enable_write_combining();
+
+  /*---------------------------------------------------------------------------
+  Test Case: Contiguous writes within a page stay in RAM
+  ---------------------------------------------------------------------------*/
+  mock().expectNoCall( "mb::hw::spi::intf::lock" );
+
+  CHECK_EQUAL( Status::ERR_OK, norDriver->write( 0x1010, &values[ 0 ], sizeof( values[ 0 ] ) ) );
+  CHECK_EQUAL( Status::ERR_OK, norDriver->write( 0x1014, &values[ 1 ], sizeof( values[ 1 ] ) ) );
+  CHECK_EQUAL( Status::ERR_OK, norDriver->write( 0x1018, &values[ 2 ], sizeof( values[ 2 ] ) ) );
+  MEMCMP_EQUAL( values, &write_buffer[ 0x10 ], sizeof( values ) );
+
+  /*---------------------------------------------------------------------------
+  Test Case: flush() issues a single page program for all of them
+  ---------------------------------------------------------------------------*/
+  mock().clear();
+  mock().ignoreOtherCalls();
+
+  expect::mb$::hw$::spi$::intf$::lock( cfg.spi_port );
+  this->expect_page_program( cfg, &write_buffer[ 0x10 ], sizeof( values ), Status::ERR_OK );
+  expect::mb$::hw$::spi$::intf$::unlock( cfg.spi_port );
+
+  CHECK_EQUAL( Status::ERR_OK, norDriver->flush() );
+
+  /* Nothing left to program */
+  mock().checkExpectations();
+  mock().clear();
+  mock().ignoreOtherCalls();
+  mock().expectNoCall( "mb::hw::spi::intf::lock" );
+  CHECK_EQUAL( Status::ERR_OK, norDriver->flush() );
+}
+
+TEST( nor_flash_write_combining, programs_on_page_boundary )
+{
+  const uint8_t tail[ 8 ] = { 1, 2, 3, 4, 5, 6, 7, 8 };
+  this->enable_write_combining();
+
+  /*---------------------------------------------------------------------------
+  Test Case: A write that reaches the end of the page goes out immediately
+  ---------------------------------------------------------------------------*/
+  expect::mb$::hw$::spi$::intf$::lock( cfg.spi_port );
+  this->expect_page_program( cfg, &write_buffer[ 0xF8 ], sizeof( tail ), Status::ERR_OK );
+  expect::mb$::hw$::spi$::intf$::unlock( cfg.spi_port );
+
+  CHECK_EQUAL( Status::ERR_OK, norDriver->write( 0x10F8, tail, sizeof( tail ) ) );
+}
+
+TEST( nor_flash_write_combining, non_contiguous_write_commits_previous )
+{
+  const uint32_t first  = 0xAAAAAAAA;
+  const uint32_t second = 0xBBBBBBBB;
+  this->enable_write_combining();
+
+  CHECK_EQUAL( Status::ERR_OK, norDriver->write( 0x1010, &first, sizeof( first ) ) );
+
+  /*---------------------------------------------------------------------------
+  Test Case: A gap in the data commits what was buffered before staging more
+  ---------------------------------------------------------------------------*/
+  expect::mb$::hw$::spi$::intf$::lock( cfg.spi_port );
+  this->expect_page_program( cfg, &write_buffer[ 0x10 ], sizeof( first ), Status::ERR_OK );
+  expect::mb$::hw$::spi$::intf$::unlock( cfg.spi_port );
+
+  CHECK_EQUAL( Status::ERR_OK, norDriver->write( 0x2040, &second, sizeof( second ) ) );
+  MEMCMP_EQUAL( &second, &write_buffer[ 0x40 ], sizeof( second ) );
+}
+
+TEST( nor_flash_write_combining, read_of_pending_page_commits_first )
+{
+  this->enable_write_combining();
+
+  input_data = 0xCAFEF00D;
+  CHECK_EQUAL( Status::ERR_OK, norDriver->write( 0x1010, &input_data, sizeof( input_data ) ) );
+
+  /*---------------------------------------------------------------------------
+  Test Case: Reading another page leaves the buffer alone
+  ---------------------------------------------------------------------------*/
+  mock().expectNoCall( "mb::memory::nor::device::adesto_at25sfxxx_pend_event" );
+  CHECK_EQUAL( Status::ERR_OK, norDriver->read( 0x2000, &output_data, sizeof( output_data ) ) );
+
+  /*---------------------------------------------------------------------------
+  Test Case: Reading the pending page programs it before the read is issued
+  ---------------------------------------------------------------------------*/
+  mock().checkExpectations();
+  mock().clear();
+  mock().ignoreOtherCalls();
+
+  this->expect_page_program( cfg, &write_buffer[ 0x10 ], sizeof( input_data ), Status::ERR_OK );
+  expect::mb$::hw$::gpio$::intf$::write( 1, cfg.spi_cs_port, cfg.spi_cs_pin, gpio::State_t::STATE_LOW );
+  expect::mb$::hw$::spi$::intf$::write( 1, cfg.spi_port, IgnoreParameter(), static_cast<size_t>( cfi::READ_ARRAY_HS_OPS_LEN ) );
+  expect::mb$::hw$::spi$::intf$::read( 1, cfg.spi_port, &output_data, sizeof( output_data ) );
+  expect::mb$::hw$::gpio$::intf$::write( 1, cfg.spi_cs_port, cfg.spi_cs_pin, gpio::State_t::STATE_HIGH );
+
+  CHECK_EQUAL( Status::ERR_OK, norDriver->read( 0x1010, &output_data, sizeof( output_data ) ) );
+}
+
+TEST( nor_flash_write_combining, erase_of_pending_page_commits_first )
+{
+  this->enable_write_combining();
+
+  CHECK_EQUAL( Status::ERR_OK, norDriver->write( 0x1010, &input_data, sizeof( input_data ) ) );
+
+  /*---------------------------------------------------------------------------
+  Test Case: The buffered data is programmed, then the block is erased
+  ---------------------------------------------------------------------------*/
+  expect::mb$::hw$::spi$::intf$::lock( cfg.spi_port );
+  this->expect_page_program( cfg, &write_buffer[ 0x10 ], sizeof( input_data ), Status::ERR_OK );
+  expect::mb$::hw$::spi$::intf$::unlock( cfg.spi_port );
+  this->expect_erase( cfi::BLOCK_ERASE_OPS_LEN, cfg.dev_attr.erase_latency );
+
+  CHECK_EQUAL( Status::ERR_OK, norDriver->erase( 1 ) );
+}
+
+TEST( nor_flash_write_combining, close_commits_pending_data )
+{
+  this->enable_write_combining();
+
+  CHECK_EQUAL( Status::ERR_OK, norDriver->write( 0x1010, &input_data, sizeof( input_data ) ) );
+
+  expect::mb$::hw$::spi$::intf$::lock( cfg.spi_port );
+  this->expect_page_program( cfg, &write_buffer[ 0x10 ], sizeof( input_data ), Status::ERR_OK );
+  expect::mb$::hw$::spi$::intf$::unlock( cfg.spi_port );
+
+  norDriver->close();
+}
+
+/*-----------------------------------------------------------------------------
+Test Case: Range erase
+-----------------------------------------------------------------------------*/
+
+TEST_GROUP_BASE( nor_flash_erase_range, NorFlashFixture )
+{
+  uint8_t erase_cmds[ 32 ][ cfi::BLOCK_ERASE_OPS_LEN ];
+  size_t  num_erase_cmds;
+
+  void setup() override
+  {
+    init_config();
+    cfg.dev_attr.erase_32k_latency = 400;
+    cfg.dev_attr.erase_64k_latency = 800;
+    cfg.dev_attr.erase_ops         = ERASE_OP_4K | ERASE_OP_32K | ERASE_OP_64K;
+
+    num_erase_cmds = 0;
+    open_driver();
+  }
+
+  void expect_erase_cmd( const uint8_t opcode, const uint32_t address )
+  {
+    using namespace mb::hw;
+
+    /*-------------------------------------------------------------------------
+    Erase commands are the opcode followed by a 24-bit big endian address
+    -------------------------------------------------------------------------*/
+    CHECK( num_erase_cmds < 32 );
+
+    size_t latency = cfg.dev_attr.erase_latency;
+    if( ( opcode == cfi::BLOCK_ERASE_32K ) && cfg.dev_attr.erase_32k_latency )
+    {
+      latency = cfg.dev_attr.erase_32k_latency;
+    }
+    else if( ( opcode == cfi::BLOCK_ERASE_64K ) && cfg.dev_attr.erase_64k_latency )
+    {
+      latency = cfg.dev_attr.erase_64k_latency;
+    }
+
+    uint8_t *cmd = erase_cmds[ num_erase_cmds++ ];
+    cmd[ 0 ]     = opcode;
+    cmd[ 1 ]     = static_cast<uint8_t>( address >> 16 );
+    cmd[ 2 ]     = static_cast<uint8_t>( address >> 8 );
+    cmd[ 3 ]     = static_cast<uint8_t>( address );
+
+    this->expect_write_enable( cfg );
+    expect::mb$::hw$::gpio$::intf$::write( 1, cfg.spi_cs_port, cfg.spi_cs_pin, gpio::State_t::STATE_LOW );
+    mock()
+        .expectOneCall( "mb::hw::spi::intf::write" )
+        .withParameter( "port", cfg.spi_port )
+        .withMemoryBufferParameter( "data", cmd, cfi::BLOCK_ERASE_OPS_LEN )
+        .withParameter( "length", static_cast<size_t>( cfi::BLOCK_ERASE_OPS_LEN ) );
+    expect::mb$::hw$::gpio$::intf$::write( 1, cfg.spi_cs_port, cfg.spi_cs_pin, gpio::State_t::STATE_HIGH );
+    expect::mb$::memory$::nor$::device$::adesto_at25sfxxx_pend_event( IgnoreParameter(), Event::MEM_ERASE_COMPLETE, latency,
+                                                                      Status::ERR_OK );
+  }
+};
+
+TEST( nor_flash_erase_range, bad_arguments )
+{
+  /*---------------------------------------------------------------------------
+  Initialize
+  ---------------------------------------------------------------------------*/
+  Status result;
+  mock().expectNoCall( "mb::hw::spi::intf::lock" );
+
+  /*---------------------------------------------------------------------------
+  Test
+  ---------------------------------------------------------------------------*/
+
+  /* No length */
+  result = norDriver->eraseRange( 0, 0 );
+  CHECK_EQUAL( Status::ERR_BAD_ARG, result );
+
+  /* Address not on a sector boundary */
+  result = norDriver->eraseRange( 0x1010, 0x1000 );
+  CHECK_EQUAL( Status::ERR_BAD_ARG, result );
+
+  /* Length not a whole number of sectors */
+  result = norDriver->eraseRange( 0x1000, 0x1800 );
+  CHECK_EQUAL( Status::ERR_BAD_ARG, result );
+
+  /* Runs off the end of the device */
+  result = norDriver->eraseRange( cfg.dev_attr.size - 0x1000, 0x2000 );
+  CHECK_EQUAL( Status::ERR_BAD_ARG, result );
+
+  /* Device doesn't advertise any erase commands */
+  norDriver->close();
+  cfg.dev_attr.erase_ops = 0;
+  norDriver->open( cfg );
+
+  result = norDriver->eraseRange( 0x1000, 0x1000 );
+  CHECK_EQUAL( Status::ERR_BAD_CFG, result );
+}
+
+TEST( nor_flash_erase_range, partition_uses_64k_blocks )
+{
+  /*---------------------------------------------------------------------------
+  Initialize
+  ---------------------------------------------------------------------------*/
+  norDriver->close();
+  cfg.dev_attr.erase_ops = ERASE_OP_4K | ERASE_OP_32K | ERASE_OP_64K | ERASE_OP_CHIP;
+  norDriver->open( cfg );
+
+  /*---------------------------------------------------------------------------
+  Test Case: A 1 MiB partition is 16 block erases, not 256 sector erases
+  ---------------------------------------------------------------------------*/
+  for( uint32_t address = 0x100000; address < 0x200000; address += 0x10000 )
+  {
+    this->expect_erase_cmd( cfi::BLOCK_ERASE_64K, address );
+  }
+
+  CHECK_EQUAL( Status::ERR_OK, norDriver->eraseRange( 0x100000, 0x100000 ) );
+}
+
+TEST( nor_flash_erase_range, mixed_alignment )
+{
+  /*---------------------------------------------------------------------------
+  Test Case: Climb to the largest alignment, then take the biggest steps
+  ---------------------------------------------------------------------------*/
+  this->expect_erase_cmd( cfi::BLOCK_ERASE_4K, 0x07000 );    // 4 KiB sector up to 32 KiB alignment
+  this->expect_erase_cmd( cfi::BLOCK_ERASE_32K, 0x08000 );    // 32 KiB block up to 64 KiB alignment
+  this->expect_erase_cmd( cfi::BLOCK_ERASE_64K, 0x10000 );    // 64 KiB block to the end
+
+  CHECK_EQUAL( Status::ERR_OK, norDriver->eraseRange( 0x07000, 0x19000 ) );
+}
+
+TEST( nor_flash_erase_range, only_uses_supported_commands )
+{
+  /*---------------------------------------------------------------------------
+  Initialize
+  ---------------------------------------------------------------------------*/
+  norDriver->close();
+  cfg.dev_attr.erase_ops = ERASE_OP_4K | ERASE_OP_64K;
+  norDriver->open( cfg );
+
+  /*---------------------------------------------------------------------------
+  Test Case: Without 32 KiB blocks the climb to 64 KiB is all sectors
+  ---------------------------------------------------------------------------*/
+  for( uint32_t address = 0x8000; address < 0x10000; address += 0x1000 )
+  {
+    this->expect_erase_cmd( cfi::BLOCK_ERASE_4K, address );
+  }
+  this->expect_erase_cmd( cfi::BLOCK_ERASE_64K, 0x10000 );
+
+  CHECK_EQUAL( Status::ERR_OK, norDriver->eraseRange( 0x8000, 0x18000 ) );
+}
+
+TEST( nor_flash_erase_range, block_latency_defaults_to_sector_latency )
+{
+  /*---------------------------------------------------------------------------
+  Initialize
+  ---------------------------------------------------------------------------*/
+  norDriver->close();
+  cfg.dev_attr.erase_32k_latency = 0;
+  cfg.dev_attr.erase_64k_latency = 0;
+  norDriver->open( cfg );
+
+  /*---------------------------------------------------------------------------
+  Test Case: Every command pends on erase_latency when no block latency is set
+  ---------------------------------------------------------------------------*/
+  this->expect_erase_cmd( cfi::BLOCK_ERASE_32K, 0x08000 );
+  this->expect_erase_cmd( cfi::BLOCK_ERASE_64K, 0x10000 );
+
+  CHECK_EQUAL( Status::ERR_OK, norDriver->eraseRange( 0x08000, 0x18000 ) );
+}
+
+TEST( nor_flash_erase_range, whole_device_uses_chip_erase )
+{
+  /*---------------------------------------------------------------------------
+  Initialize
+  ---------------------------------------------------------------------------*/
+  norDriver->close();
+  cfg.dev_attr.erase_ops = ERASE_OP_4K | ERASE_OP_64K | ERASE_OP_CHIP;
+  norDriver->open( cfg );
+
+  this->expect_erase( cfi::CHIP_ERASE_OPS_LEN, cfg.dev_attr.erase_chip_latency );
+
+  /*---------------------------------------------------------------------------
+  Test
+  ---------------------------------------------------------------------------*/
+  CHECK_EQUAL( Status::ERR_OK, norDriver->eraseRange( 0, cfg.dev_attr.size ) );
+}
+
+/*-----------------------------------------------------------------------------
+Test Case: Blank check before erase
+-----------------------------------------------------------------------------*/
+
+TEST_GROUP_BASE( nor_flash_blank_check, NorFlashFixture )
+{
+  uint8_t blank_buffer[ 256 ];
+  uint8_t blank_page[ 256 ];
+  uint8_t dirty_page[ 256 ];
+
+  void setup() override
+  {
+    NorFlashFixture::setup();
+
+    memset( blank_page, 0xFF, sizeof( blank_page ) );
+    memset( dirty_page, 0xFF, sizeof( dirty_page ) );
+    dirty_page[ 0x80 ] = 0xFE;
+  }
+
+  void enable_blank_check()
+  {
+    norDriver->close();
+    cfg.blank_check_buffer = blank_buffer;
+    norDriver->open( cfg );
+  }
+
+  void expect_blank_check( const uint8_t *const *pages, const size_t num_pages )
+  {
+    using namespace mb::hw;
+
+    /*-------------------------------------------------------------------------
+    The region is streamed back a page at a time under a single command
+    -------------------------------------------------------------------------*/
+    expect::mb$::hw$::gpio$::intf$::write( 1, cfg.spi_cs_port, cfg.spi_cs_pin, gpio::State_t::STATE_LOW );
+    expect::mb$::hw$::spi$::intf$::write( 1, cfg.spi_port, IgnoreParameter(), static_cast<size_t>( cfi::READ_ARRAY_HS_OPS_LEN ) );
+    for( size_t i = 0; i < num_pages; i++ )
+    {
+      mock()
+          .expectOneCall( "mb::hw::spi::intf::read" )
+          .withParameter( "port", cfg.spi_port )
+          .withOutputParameterReturning( "data", pages[ i ], cfg.dev_attr.read_size )
+          .withParameter( "length", cfg.dev_attr.read_size )
+          .ignoreOtherParameters();
+    }
+    expect::mb$::hw$::gpio$::intf$::write( 1, cfg.spi_cs_port, cfg.spi_cs_pin, gpio::State_t::STATE_HIGH );
+  }
+};
+
+TEST( nor_flash_blank_check, disabled_by_default )
+{
+  /*---------------------------------------------------------------------------
+  Test Case: The erase goes straight out without reading the block
+  ---------------------------------------------------------------------------*/
+  mock().expectNoCall( "mb::hw::spi::intf::read" );
+  this->expect_erase( cfi::BLOCK_ERASE_OPS_LEN, cfg.dev_attr.erase_latency );
+
+  CHECK_EQUAL( Status::ERR_OK, norDriver->erase( 1 ) );
+  CHECK_EQUAL( 0, norDriver->stats().erase_skipped );
+}
+
+TEST( nor_flash_blank_check, skips_erased_block )
+{
+  const uint8_t *pages[ 16 ];
+  for( auto &page : pages )
+  {
+    page = blank_page;
+  }
+
+  this->enable_blank_check();
+
+  /*---------------------------------------------------------------------------
+  Test Case: All 0xFF means no erase command and no wear
+  ---------------------------------------------------------------------------*/
+  expect::mb$::hw$::spi$::intf$::lock( cfg.spi_port );
+  this->expect_blank_check( pages, 16 );
+  expect::mb$::hw$::spi$::intf$::unlock( cfg.spi_port );
+  mock().expectNoCall( "mb::memory::nor::device::adesto_at25sfxxx_pend_event" );
+
+  CHECK_EQUAL( Status::ERR_OK, norDriver->erase( 1 ) );
+  CHECK_EQUAL( 1, norDriver->stats().erase_skipped );
+}
+
+TEST( nor_flash_blank_check, erases_dirty_block )
+{
+  const uint8_t *pages[ 2 ] = { blank_page, dirty_page };
+  this->enable_blank_check();
+
+  /*---------------------------------------------------------------------------
+  Test Case: Reading stops at the first programmed byte, then the block is
+  erased as usual.
+  ---------------------------------------------------------------------------*/
+  expect::mb$::hw$::spi$::intf$::lock( 2, cfg.spi_port );
+  expect::mb$::hw$::spi$::intf$::unlock( 2, cfg.spi_port );
+  this->expect_blank_check( pages, 2 );
+  this->expect_write_enable( cfg );
+  expect::mb$::hw$::gpio$::intf$::write( 1, cfg.spi_cs_port, cfg.spi_cs_pin, gpio::State_t::STATE_LOW );
+  expect::mb$::hw$::spi$::intf$::write( 1, cfg.spi_port, IgnoreParameter(), static_cast<size_t>( cfi::BLOCK_ERASE_OPS_LEN ) );
+  expect::mb$::hw$::gpio$::intf$::write( 1, cfg.spi_cs_port, cfg.spi_cs_pin, gpio::State_t::STATE_HIGH );
+  expect::mb$::memory$::nor$::device$::adesto_at25sfxxx_pend_event( IgnoreParameter(), Event::MEM_ERASE_COMPLETE,
+                                                                    cfg.dev_attr.erase_latency, Status::ERR_OK );
+
+  CHECK_EQUAL( Status::ERR_OK, norDriver->erase( 1 ) );
+  CHECK_EQUAL( 0, norDriver->stats().erase_skipped );
+}
+
+TEST( nor_flash_blank_check, counts_skipped_erases )
+{
+  const uint8_t *pages[ 16 ];
+  for( auto &page : pages )
+  {
+    page = blank_page;
+  }
+
+  this->enable_blank_check();
+
+  /*---------------------------------------------------------------------------
+  Test Case: Every avoided erase is counted
+  ---------------------------------------------------------------------------*/
+  for( size_t block = 0; block < 3; block++ )
+  {
+    this->expect_blank_check( pages, 16 );
+  }
+  mock().expectNoCall( "mb::memory::nor::device::adesto_at25sfxxx_pend_event" );
+
+  for( size_t block = 0; block < 3; block++ )
+  {
+    CHECK_EQUAL( Status::ERR_OK, norDriver->erase( block ) );
+  }
+
+  CHECK_EQUAL( 3, norDriver->stats().erase_skipped );
+}
+
+/*-----------------------------------------------------------------------------
+Test Case: Erase suspend/resume
+-----------------------------------------------------------------------------*/
+
+TEST_GROUP_BASE( nor_flash_suspend, NorFlashAsyncFixture )
+{
+  void start_async_erase( const size_t block_idx, const size_t start_ms )
+  {
+    using namespace mb::hw;
+
+    /*-------------------------------------------------------------------------
+    Issue the erase command without waiting for it to finish
+    -------------------------------------------------------------------------*/
+    expect::mb$::hw$::spi$::intf$::lock( cfg.spi_port );
+    this->expect_write_enable( cfg );
+    expect::mb$::hw$::gpio$::intf$::write( 1, cfg.spi_cs_port, cfg.spi_cs_pin, gpio::State_t::STATE_LOW );
+    expect::mb$::hw$::spi$::intf$::write( 1, cfg.spi_port, IgnoreParameter(), static_cast<size_t>( cfi::BLOCK_ERASE_OPS_LEN ) );
+    expect::mb$::hw$::gpio$::intf$::write( 1, cfg.spi_cs_port, cfg.spi_cs_pin, gpio::State_t::STATE_HIGH );
+    expect::mb$::hw$::spi$::intf$::unlock( cfg.spi_port );
+    expect::mb$::time$::millis( start_ms );
+
+    auto cb = CompletionCallback::create<cb_async_complete>();
+    CHECK_EQUAL( Status::ERR_OK, norDriver->eraseAsync( block_idx, cb ) );
+  }
+
+  void expect_single_byte_cmd( const uint8_t *cmd )
+  {
+    using namespace mb::hw;
+
+    expect::mb$::hw$::gpio$::intf$::write( 1, cfg.spi_cs_port, cfg.spi_cs_pin, gpio::State_t::STATE_LOW );
+    mock()
+        .expectOneCall( "mb::hw::spi::intf::write" )
+        .withParameter( "port", cfg.spi_port )
+        .withMemoryBufferParameter( "data", cmd, 1 )
+        .withParameter( "length", static_cast<size_t>( 1 ) );
+    expect::mb$::hw$::gpio$::intf$::write( 1, cfg.spi_cs_port, cfg.spi_cs_pin, gpio::State_t::STATE_HIGH );
+  }
+};
+
+TEST( nor_flash_suspend, read_during_erase_without_suspend_support )
+{
+  this->start_async_erase( 1, 100 );
+
+  /*---------------------------------------------------------------------------
+  Test Case: A part without suspend makes the reader wait for the erase
+  ---------------------------------------------------------------------------*/
+  mock().expectNoCall( "mb::hw::spi::intf::read" );
+  CHECK_EQUAL( Status::ERR_BUSY, norDriver->read( 0x4000, &output_data, sizeof( output_data ) ) );
+}
+
+TEST( nor_flash_suspend, read_during_erase_suspends_and_resumes )
+{
+  static const uint8_t suspend_cmd = 0x75;
+  static const uint8_t resume_cmd  = 0x7A;
+
+  norDriver->close();
+  cfg.dev_attr.suspend_latency = 1;
+  norDriver->open( cfg );
+
+  this->start_async_erase( 1, 100 );
+
+  /*---------------------------------------------------------------------------
+  Test Case: The erase is suspended just long enough to serve the read
+  ---------------------------------------------------------------------------*/
+  expect::mb$::hw$::spi$::intf$::lock( cfg.spi_port );
+  this->expect_single_byte_cmd( &suspend_cmd );
+  expect::mb$::memory$::nor$::device$::adesto_at25sfxxx_pend_event( IgnoreParameter(), Event::MEM_SUSPEND_COMPLETE,
+                                                                    cfg.dev_attr.suspend_latency, Status::ERR_OK );
+  expect::mb$::hw$::gpio$::intf$::write( 1, cfg.spi_cs_port, cfg.spi_cs_pin, gpio::State_t::STATE_LOW );
+  expect::mb$::hw$::spi$::intf$::write( 1, cfg.spi_port, IgnoreParameter(), static_cast<size_t>( cfi::READ_ARRAY_HS_OPS_LEN ) );
+  expect::mb$::hw$::spi$::intf$::read( 1, cfg.spi_port, &output_data, sizeof( output_data ) );
+  expect::mb$::hw$::gpio$::intf$::write( 1, cfg.spi_cs_port, cfg.spi_cs_pin, gpio::State_t::STATE_HIGH );
+  this->expect_single_byte_cmd( &resume_cmd );
+  expect::mb$::hw$::spi$::intf$::unlock( cfg.spi_port );
+
+  CHECK_EQUAL( Status::ERR_OK, norDriver->read( 0x4000, &output_data, sizeof( output_data ) ) );
+
+  /*---------------------------------------------------------------------------
+  Test Case: The erase is still owned by the async machinery afterwards
+  ---------------------------------------------------------------------------*/
+  CHECK( norDriver->isBusy() );
+  CHECK_EQUAL( 0, s_async_calls );
+
+  expect::mb$::memory$::nor$::device$::adesto_at25sfxxx_poll_event( IgnoreParameter(), Event::MEM_ERASE_COMPLETE, Status::ERR_OK );
+  norDriver->process();
+
+  CHECK_EQUAL( 1, s_async_calls );
+  CHECK( s_async_event == Event::MEM_ERASE_COMPLETE );
+  CHECK_EQUAL( Status::ERR_OK, s_async_status );
+}
+
+TEST( nor_flash_suspend, read_during_erase_suspend_timeout )
+{
+  static const uint8_t suspend_cmd = 0x75;
+  static const uint8_t resume_cmd  = 0x7A;
+
+  norDriver->close();
+  cfg.dev_attr.suspend_latency = 1;
+  norDriver->open( cfg );
+
+  this->start_async_erase( 1, 100 );
+
+  /*---------------------------------------------------------------------------
+  Test Case: If the part never reports suspended, don't read array data.
+  Resume is still sent so the erase can't be left parked.
+  ---------------------------------------------------------------------------*/
+  expect::mb$::hw$::spi$::intf$::lock( cfg.spi_port );
+  this->expect_single_byte_cmd( &suspend_cmd );
+  expect::mb$::memory$::nor$::device$::adesto_at25sfxxx_pend_event( IgnoreParameter(), Event::MEM_SUSPEND_COMPLETE,
+                                                                    cfg.dev_attr.suspend_latency, Status::ERR_TIMEOUT );
+  this->expect_single_byte_cmd( &resume_cmd );
+  expect::mb$::hw$::spi$::intf$::unlock( cfg.spi_port );
+  mock().expectNoCall( "mb::hw::spi::intf::read" );
+
+  CHECK_EQUAL( Status::ERR_TIMEOUT, norDriver->read( 0x4000, &output_data, sizeof( output_data ) ) );
+  CHECK( norDriver->isBusy() );
+}
+
+TEST( nor_flash_suspend, read_of_block_being_erased_is_rejected )
+{
+  norDriver->close();
+  cfg.dev_attr.suspend_latency = 1;
+  norDriver->open( cfg );
+
+  this->start_async_erase( 1, 100 );
+
+  /*---------------------------------------------------------------------------
+  Test Case: Block 1 covers 0x1000-0x1FFF. Its contents are undefined until
+  the erase finishes, so suspending to read it is pointless. No suspend (0x75)
+  or any other command may go out on the bus.
+  ---------------------------------------------------------------------------*/
+  mock().expectNoCall( "mb::hw::spi::intf::lock" );
+  mock().expectNoCall( "mb::hw::spi::intf::write" );
+  mock().expectNoCall( "mb::hw::spi::intf::read" );
+  mock().expectNoCall( "mb::memory::nor::device::adesto_at25sfxxx_pend_event" );
+
+  /* First and last words of the block */
+  CHECK_EQUAL( Status::ERR_BUSY, norDriver->read( 0x1000, &output_data, sizeof( output_data ) ) );
+  CHECK_EQUAL( Status::ERR_BUSY, norDriver->read( 0x1FFC, &output_data, sizeof( output_data ) ) );
+
+  /* Straddles the start of the block */
+  uint64_t straddle = 0;
+  CHECK_EQUAL( Status::ERR_BUSY, norDriver->read( 0x0FFC, &straddle, sizeof( straddle ) ) );
+
+  CHECK( norDriver->isBusy() );
+  CHECK_EQUAL( 0, s_async_calls );
+}
+
+TEST( nor_flash_suspend, program_during_suspended_erase_is_rejected )
+{
+  norDriver->close();
+  cfg.dev_attr.suspend_latency = 1;
+  norDriver->open( cfg );
+
+  this->start_async_erase( 1, 100 );
+
+  /*---------------------------------------------------------------------------
+  Test Case: Only reads may preempt an erase
+  ---------------------------------------------------------------------------*/
+  mock().expectNoCall( "mb::memory::nor::device::adesto_at25sfxxx_pend_event" );
+  CHECK_EQUAL( Status::ERR_BUSY, norDriver->write( 0x8000, &input_data, sizeof( input_data ) ) );
+  CHECK_EQUAL( Status::ERR_BUSY, norDriver->erase( 4 ) );
+}
+
+/*-----------------------------------------------------------------------------
+Test Case: Batched transactions
+-----------------------------------------------------------------------------*/
+
+TEST_GROUP_BASE( nor_flash_execute, NorFlashFixture )
+{
+};
+
+TEST( nor_flash_execute, bad_arguments )
+{
+  /*---------------------------------------------------------------------------
+  Initialize
+  ---------------------------------------------------------------------------*/
+  Transaction txns[ 2 ] = {
+    { .op = Transaction::Op::READ, .address = 0x1000, .rx = &output_data, .length = sizeof( output_data ) },
+    { .op = Transaction::Op::READ, .address = 0x1000, .rx = nullptr, .length = sizeof( output_data ) },
+  };
+
+  mock().expectNoCall( "mb::osal::lockMutex" );
+  mock().expectNoCall( "mb::hw::spi::intf::lock" );
+
+  /*---------------------------------------------------------------------------
+  Test
+  ---------------------------------------------------------------------------*/
+
+  /* Nothing to do */
+  CHECK_EQUAL( Status::ERR_BAD_ARG, norDriver->execute( etl::span<Transaction>() ) );
+
+  /* Every descriptor is validated before the bus is touched */
+  CHECK_EQUAL( Status::ERR_BAD_ARG, norDriver->execute( etl::span<Transaction>( txns ) ) );
+
+  /* Not open */
+  norDriver->close();
+  CHECK_EQUAL( Status::ERR_BAD_STATE, norDriver->execute( etl::span<Transaction>( txns, 1 ) ) );
+}
+
+TEST( nor_flash_execute, runs_sequence_under_one_lock )
+{
+  /*---------------------------------------------------------------------------
+  Initialize
+  ---------------------------------------------------------------------------*/
+  input_data = 0xA5A5A5A5;
+
+  Transaction txns[ 2 ] = {
+    { .op = Transaction::Op::WRITE, .address = 0x1000, .tx = &input_data, .length = sizeof( input_data ) },
+    { .op = Transaction::Op::READ, .address = 0x1000, .rx = &output_data, .length = sizeof( output_data ) },
+  };
+
+  expect::mb$::osal$::lockMutex( IgnoreParameter() );
+  expect::mb$::hw$::spi$::intf$::lock( cfg.spi_port );
+
+  this->expect_page_program( cfg, &input_data, sizeof( input_data ), Status::ERR_OK );
+
+  expect::mb$::hw$::gpio$::intf$::write( 1, cfg.spi_cs_port, cfg.spi_cs_pin, gpio::State_t::STATE_LOW );
+  expect::mb$::hw$::spi$::intf$::write( 1, cfg.spi_port, IgnoreParameter(), static_cast<size_t>( cfi::READ_ARRAY_HS_OPS_LEN ) );
+  expect::mb$::hw$::spi$::intf$::read( 1, cfg.spi_port, &output_data, sizeof( output_data ) );
+  expect::mb$::hw$::gpio$::intf$::write( 1, cfg.spi_cs_port, cfg.spi_cs_pin, gpio::State_t::STATE_HIGH );
+
+  expect::mb$::hw$::spi$::intf$::unlock( cfg.spi_port );
+  expect::mb$::osal$::unlockMutex( IgnoreParameter() );
+
+  /*---------------------------------------------------------------------------
+  Test
+  ---------------------------------------------------------------------------*/
+  CHECK_EQUAL( Status::ERR_OK, norDriver->execute( etl::span<Transaction>( txns ) ) );
+  CHECK_EQUAL( Status::ERR_OK, txns[ 0 ].status );
+  CHECK_EQUAL( Status::ERR_OK, txns[ 1 ].status );
+}
+
+TEST( nor_flash_execute, merges_contiguous_reads )
+{
+  /*---------------------------------------------------------------------------
+  Initialize
+  ---------------------------------------------------------------------------*/
+  uint32_t header  = 0;
+  uint32_t length  = 0;
+  uint64_t payload = 0;
+  uint32_t other   = 0;
+
+  Transaction txns[ 4 ] = {
+    { .op = Transaction::Op::READ, .address = 0x2000, .rx = &header, .length = sizeof( header ) },
+    { .op = Transaction::Op::READ, .address = 0x2004, .rx = &length, .length = sizeof( length ) },
+    { .op = Transaction::Op::READ, .address = 0x2008, .rx = &payload, .length = sizeof( payload ) },
+    { .op = Transaction::Op::READ, .address = 0x3000, .rx = &other, .length = sizeof( other ) },
+  };
+
+  /*---------------------------------------------------------------------------
+  The first three reads share one command and one chip select. The fourth
+  isn't contiguous so it gets its own.
+  ---------------------------------------------------------------------------*/
+  expect::mb$::osal$::lockMutex( IgnoreParameter() );
+  expect::mb$::hw$::spi$::intf$::lock( cfg.spi_port );
+  expect::mb$::hw$::gpio$::intf$::write( 2, cfg.spi_cs_port, cfg.spi_cs_pin, gpio::State_t::STATE_LOW );
+  expect::mb$::hw$::spi$::intf$::write( 2, cfg.spi_port, IgnoreParameter(), static_cast<size_t>( cfi::READ_ARRAY_HS_OPS_LEN ) );
+  expect::mb$::hw$::spi$::intf$::read( 1, cfg.spi_port, &header, sizeof( header ) );
+  expect::mb$::hw$::spi$::intf$::read( 1, cfg.spi_port, &length, sizeof( length ) );
+  expect::mb$::hw$::spi$::intf$::read( 1, cfg.spi_port, &payload, sizeof( payload ) );
+  expect::mb$::hw$::spi$::intf$::read( 1, cfg.spi_port, &other, sizeof( other ) );
+  expect::mb$::hw$::gpio$::intf$::write( 2, cfg.spi_cs_port, cfg.spi_cs_pin, gpio::State_t::STATE_HIGH );
+  expect::mb$::hw$::spi$::intf$::unlock( cfg.spi_port );
+  expect::mb$::osal$::unlockMutex( IgnoreParameter() );
+
+  /*---------------------------------------------------------------------------
+  Test
+  ---------------------------------------------------------------------------*/
+  CHECK_EQUAL( Status::ERR_OK, norDriver->execute( etl::span<Transaction>( txns ) ) );
+}
+
+TEST( nor_flash_execute, stops_at_first_failure )
+{
+  /*---------------------------------------------------------------------------
+  Initialize
+  ---------------------------------------------------------------------------*/
+  Transaction txns[ 2 ] = {
+    { .op = Transaction::Op::WRITE, .address = 0x1000, .tx = &input_data, .length = sizeof( input_data ) },
+    { .op = Transaction::Op::READ, .address = 0x1000, .rx = &output_data, .length = sizeof( output_data ) },
+  };
+
+  expect::mb$::osal$::lockMutex( IgnoreParameter() );
+  expect::mb$::hw$::spi$::intf$::lock( cfg.spi_port );
+  this->expect_page_program( cfg, &input_data, sizeof( input_data ), Status::ERR_TIMEOUT );
+  expect::mb$::hw$::spi$::intf$::unlock( cfg.spi_port );
+  expect::mb$::osal$::unlockMutex( IgnoreParameter() );
+  mock().expectNoCall( "mb::hw::spi::intf::read" );
+
+  /*---------------------------------------------------------------------------
+  Test
+  ---------------------------------------------------------------------------*/
+  CHECK_EQUAL( Status::ERR_TIMEOUT, norDriver->execute( etl::span<Transaction>( txns ) ) );
+  CHECK_EQUAL( Status::ERR_TIMEOUT, txns[ 0 ].status );
+  CHECK_EQUAL( Status::ERR_BAD_STATE, txns[ 1 ].status );
+}
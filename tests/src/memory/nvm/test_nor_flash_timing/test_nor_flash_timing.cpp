@@ -0,0 +1,282 @@
+/******************************************************************************
+ *  File Name:
+ *    test_nor_flash_timing.cpp
+ *
+ *  Description:
+ *    Test cases for the FileFlash timing model in nor_flash_timing.hpp
+ *
+ *  2024 | Brandon Braun | brandonbraun653@protonmail.com
+ *****************************************************************************/
+
+/*-----------------------------------------------------------------------------
+Includes
+-----------------------------------------------------------------------------*/
+
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <mbedutils/drivers/memory/nvm/nor_flash.hpp>
+
+#include <CppUTest/CommandLineTestRunner.h>
+#include <CppUTest/TestHarness.h>
+#include <CppUTestExt/MockSupport.h>
+#include "nor_flash_file.hpp"
+
+#include <tests/harness/nor_flash_timing.hpp>
+
+using namespace TestHarness;
+
+/*-----------------------------------------------------------------------------
+Constants
+-----------------------------------------------------------------------------*/
+
+static constexpr const char *FLASH_FILE = "flash_timing_test.bin";
+
+/*-----------------------------------------------------------------------------
+Tests
+-----------------------------------------------------------------------------*/
+
+int main( int argc, char **argv )
+{
+  return RUN_ALL_TESTS( argc, argv );
+}
+
+
+TEST_GROUP( nor_flash_timing )
+{
+  fake::memory::nor::FileFlash  flash;
+  mb::memory::nor::DeviceConfig cfg;
+  FlashTiming                   timing;
+  TimedFileFlash                timed;
+  uint8_t                       data[ 512 ];
+
+  void setup()
+  {
+    mock().ignoreOtherCalls();
+
+    /*-------------------------------------------------------------------------
+    64 KiB part with 4 KiB sectors and 256 byte pages. An 8 MHz bus moves one
+    byte per microsecond, which keeps the expected bus times easy to read.
+    -------------------------------------------------------------------------*/
+    memset( &cfg, 0, sizeof( cfg ) );
+    cfg.dev_attr.block_size         = 4096;
+    cfg.dev_attr.erase_size         = 4096;
+    cfg.dev_attr.write_size         = 256;
+    cfg.dev_attr.size               = 0x10000;
+    cfg.dev_attr.write_latency      = 2;
+    cfg.dev_attr.erase_latency      = 50;
+    cfg.dev_attr.erase_chip_latency = 1000;
+
+    timing = {
+      .mode         = FlashTimingMode::VIRTUAL_CLOCK,
+      .spi_clock_hz = 8000000,
+      .cmd_overhead = 4,
+    };
+
+    memset( data, 0xA5, sizeof( data ) );
+
+    std::remove( FLASH_FILE );
+    flash.open( FLASH_FILE, cfg );
+    timed.attach( &flash, cfg, timing );
+  }
+
+  void teardown()
+  {
+    flash.close();
+    std::remove( FLASH_FILE );
+    mock().checkExpectations();
+    mock().clear();
+  }
+};
+
+
+TEST( nor_flash_timing, read_only_costs_bus_time )
+{
+  CHECK( timed.read( 0x100, data, 100 ) == mb::memory::Status::ERR_OK );
+
+  const FlashTimingStats s = timed.stats();
+  CHECK_EQUAL( 104, s.bus_us );    // 4 command bytes + 100 data bytes
+  CHECK_EQUAL( 0, s.write_us );
+  CHECK_EQUAL( 0, s.erase_us );
+  CHECK_EQUAL( 1, s.reads );
+  CHECK_EQUAL( 0, s.writes );
+  CHECK_EQUAL( 0, s.erases );
+}
+
+
+TEST( nor_flash_timing, write_is_split_on_page_boundaries )
+{
+  /*---------------------------------------------------------------------------
+  300 bytes from 0xF0 program 16 + 256 + 28 bytes across three pages
+  ---------------------------------------------------------------------------*/
+  CHECK( timed.write( 0xF0, data, 300 ) == mb::memory::Status::ERR_OK );
+
+  const FlashTimingStats s = timed.stats();
+  CHECK_EQUAL( 312, s.bus_us );      // ( 4 + 16 ) + ( 4 + 256 ) + ( 4 + 28 )
+  CHECK_EQUAL( 6000, s.write_us );    // 3 pages * 2 ms
+  CHECK_EQUAL( 0, s.erase_us );
+  CHECK_EQUAL( 3, s.writes );
+  CHECK_EQUAL( 6312, s.total_us() );
+}
+
+
+TEST( nor_flash_timing, whole_device_erase_is_a_chip_erase )
+{
+  CHECK( timed.erase( 0, cfg.dev_attr.size ) == mb::memory::Status::ERR_OK );
+
+  const FlashTimingStats s = timed.stats();
+  CHECK_EQUAL( 1, s.bus_us );    // Single opcode byte
+  CHECK_EQUAL( 1000000, s.erase_us );
+  CHECK_EQUAL( 1, s.erases );
+}
+
+
+TEST( nor_flash_timing, multi_block_erase_costs_every_block )
+{
+  /*---------------------------------------------------------------------------
+  Test Case: Three whole sectors
+  ---------------------------------------------------------------------------*/
+  CHECK( timed.erase( 0x1000, 0x3000 ) == mb::memory::Status::ERR_OK );
+
+  FlashTimingStats s = timed.stats();
+  CHECK_EQUAL( 12, s.bus_us );    // 3 * 4 command bytes
+  CHECK_EQUAL( 150000, s.erase_us );
+  CHECK_EQUAL( 3, s.erases );
+
+  /*---------------------------------------------------------------------------
+  Test Case: A partial sector still pays for the whole sector
+  ---------------------------------------------------------------------------*/
+  timed.reset();
+  CHECK( timed.erase( 0x8000, 0x1800 ) == mb::memory::Status::ERR_OK );
+
+  s = timed.stats();
+  CHECK_EQUAL( 8, s.bus_us );
+  CHECK_EQUAL( 100000, s.erase_us );
+  CHECK_EQUAL( 2, s.erases );
+
+  /*---------------------------------------------------------------------------
+  Test Case: An unaligned start straddles two sectors
+  ---------------------------------------------------------------------------*/
+  timed.reset();
+  CHECK( timed.erase( 0x8800, 0x1000 ) == mb::memory::Status::ERR_OK );
+
+  s = timed.stats();
+  CHECK_EQUAL( 8, s.bus_us );
+  CHECK_EQUAL( 100000, s.erase_us );
+  CHECK_EQUAL( 2, s.erases );
+}
+
+
+TEST( nor_flash_timing, failed_operations_are_not_charged )
+{
+  /*---------------------------------------------------------------------------
+  Everything here starts past the end of the device
+  ---------------------------------------------------------------------------*/
+  CHECK( timed.read( cfg.dev_attr.size, data, 16 ) != mb::memory::Status::ERR_OK );
+  CHECK( timed.write( cfg.dev_attr.size, data, 16 ) != mb::memory::Status::ERR_OK );
+  CHECK( timed.erase( cfg.dev_attr.size, cfg.dev_attr.erase_size ) != mb::memory::Status::ERR_OK );
+
+  const FlashTimingStats s = timed.stats();
+  CHECK_EQUAL( 0, s.total_us() );
+  CHECK_EQUAL( 0, s.reads );
+  CHECK_EQUAL( 0, s.writes );
+  CHECK_EQUAL( 0, s.erases );
+}
+
+
+TEST( nor_flash_timing, attach_keeps_statistics )
+{
+  CHECK( timed.write( 0, data, 4 ) == mb::memory::Status::ERR_OK );
+  timed.attach( &flash, cfg, timing );
+
+  const FlashTimingStats s = timed.stats();
+  CHECK_EQUAL( 8, s.bus_us );
+  CHECK_EQUAL( 2000, s.write_us );
+  CHECK_EQUAL( 1, s.writes );
+}
+
+
+TEST( nor_flash_timing, read_cache_only_charges_misses )
+{
+  timed.enable_read_cache( 2, 256 );
+
+  /*---------------------------------------------------------------------------
+  Test Case: A read spanning two pages fetches both of them whole
+  ---------------------------------------------------------------------------*/
+  CHECK( timed.read( 0x80, data, 256 ) == mb::memory::Status::ERR_OK );
+
+  FlashTimingStats s = timed.stats();
+  CHECK_EQUAL( 520, s.bus_us );    // 2 * ( 4 + 256 )
+  CHECK_EQUAL( 2, s.reads );
+  CHECK_EQUAL( 2, s.cache_misses );
+  CHECK_EQUAL( 0, s.cache_hits );
+
+  /*---------------------------------------------------------------------------
+  Test Case: Re-reading a cached header never touches the bus
+  ---------------------------------------------------------------------------*/
+  timed.reset();
+  CHECK( timed.read( 0x00, data, 16 ) == mb::memory::Status::ERR_OK );
+  CHECK( timed.read( 0x100, data, 16 ) == mb::memory::Status::ERR_OK );
+
+  s = timed.stats();
+  CHECK_EQUAL( 0, s.bus_us );
+  CHECK_EQUAL( 0, s.reads );
+  CHECK_EQUAL( 2, s.cache_hits );
+
+  /*---------------------------------------------------------------------------
+  Test Case: A third page evicts the least recently used one (page 0)
+  ---------------------------------------------------------------------------*/
+  timed.reset();
+  CHECK( timed.read( 0x200, data, 4 ) == mb::memory::Status::ERR_OK );
+  CHECK( timed.read( 0x100, data, 4 ) == mb::memory::Status::ERR_OK );
+  CHECK( timed.read( 0x000, data, 4 ) == mb::memory::Status::ERR_OK );
+
+  s = timed.stats();
+  CHECK_EQUAL( 1, s.cache_hits );
+  CHECK_EQUAL( 2, s.cache_misses );
+}
+
+
+TEST( nor_flash_timing, read_cache_dropped_by_write_and_erase )
+{
+  timed.enable_read_cache( 4, 256 );
+
+  CHECK( timed.read( 0x0000, data, 4 ) == mb::memory::Status::ERR_OK );
+  CHECK( timed.read( 0x1000, data, 4 ) == mb::memory::Status::ERR_OK );
+
+  /*---------------------------------------------------------------------------
+  Test Case: Programming a page drops it from the cache
+  ---------------------------------------------------------------------------*/
+  CHECK( timed.write( 0x0010, data, 4 ) == mb::memory::Status::ERR_OK );
+  timed.reset();
+  CHECK( timed.read( 0x0000, data, 4 ) == mb::memory::Status::ERR_OK );
+  CHECK_EQUAL( 1, timed.stats().cache_misses );
+
+  /*---------------------------------------------------------------------------
+  Test Case: Erasing a sector drops every page inside it
+  ---------------------------------------------------------------------------*/
+  CHECK( timed.erase( 0x1000, 0x1000 ) == mb::memory::Status::ERR_OK );
+  timed.reset();
+  CHECK( timed.read( 0x1000, data, 4 ) == mb::memory::Status::ERR_OK );
+  CHECK( timed.read( 0x0000, data, 4 ) == mb::memory::Status::ERR_OK );
+
+  const FlashTimingStats s = timed.stats();
+  CHECK_EQUAL( 1, s.cache_misses );
+  CHECK_EQUAL( 1, s.cache_hits );
+}
+
+
+TEST( nor_flash_timing, real_time_mode_sleeps_for_simulated_time )
+{
+  timing.mode = FlashTimingMode::REAL_TIME;
+  timed.attach( &flash, cfg, timing );
+
+  const auto start = std::chrono::steady_clock::now();
+  CHECK( timed.write( 0, data, 4 ) == mb::memory::Status::ERR_OK );
+  const auto elapsed = std::chrono::steady_clock::now() - start;
+
+  const FlashTimingStats s = timed.stats();
+  CHECK_EQUAL( 2008, s.total_us() );
+  CHECK( std::chrono::duration_cast<std::chrono::microseconds>( elapsed ).count() >= 2008 );
+}
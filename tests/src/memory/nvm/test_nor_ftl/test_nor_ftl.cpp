@@ -0,0 +1,433 @@
+/******************************************************************************
+ *  File Name:
+ *    test_nor_ftl.cpp
+ *
+ *  Description:
+ *    Test cases for nor_ftl.cpp
+ *
+ *  2024 | Brandon Braun | brandonbraun653@protonmail.com
+ *****************************************************************************/
+
+/*-----------------------------------------------------------------------------
+Includes
+-----------------------------------------------------------------------------*/
+#include <algorithm>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <mbedutils/drivers/memory/nvm/nor_flash.hpp>
+#include <mbedutils/drivers/memory/nvm/nor_ftl.hpp>
+
+#include <CppUTest/CommandLineTestRunner.h>
+#include <CppUTest/TestHarness.h>
+#include <CppUTestExt/MockSupport.h>
+#include "nor_flash_file.hpp"
+
+using namespace mb::memory;
+using namespace mb::memory::nor;
+
+/*-----------------------------------------------------------------------------
+Constants
+-----------------------------------------------------------------------------*/
+
+static constexpr size_t PAGE_SIZE  = 256;
+static constexpr size_t BLOCK_SIZE = 4096;
+static constexpr size_t NUM_BLOCKS = 64;
+
+/*-----------------------------------------------------------------------------
+Static Data
+-----------------------------------------------------------------------------*/
+
+static fake::memory::nor::FileFlash *s_flash;
+static size_t                        s_flash_writes;
+static size_t                        s_flash_erases;
+static uint64_t                      s_last_write_address;
+
+/*-----------------------------------------------------------------------------
+Static Functions
+-----------------------------------------------------------------------------*/
+
+static Status backend_read( const uint64_t address, void *const data, const size_t length )
+{
+  return s_flash->read( address, data, length );
+}
+
+static Status backend_write( const uint64_t address, const void *const data, const size_t length )
+{
+  s_flash_writes++;
+  s_last_write_address = address;
+  return s_flash->write( address, data, length );
+}
+
+static Status backend_erase( const size_t block_idx )
+{
+  s_flash_erases++;
+  return s_flash->erase( block_idx * BLOCK_SIZE, BLOCK_SIZE );
+}
+
+/**
+ * @brief Fills a buffer with a pattern unique to a logical page and version
+ */
+static void fill_pattern( uint8_t *buffer, const size_t size, const size_t lpage, const size_t version )
+{
+  for( size_t i = 0; i < size; i++ )
+  {
+    buffer[ i ] = static_cast<uint8_t>( ( lpage * 31 ) ^ ( version * 7 ) ^ i );
+  }
+}
+
+/*-----------------------------------------------------------------------------
+Tests
+-----------------------------------------------------------------------------*/
+
+int main( int argc, char **argv )
+{
+  return RUN_ALL_TESTS( argc, argv );
+}
+
+
+TEST_GROUP( nor_ftl )
+{
+  ftl::FTL       *test_ftl;
+  ftl::Config     cfg;
+  uint32_t        map[ NUM_BLOCKS * ( BLOCK_SIZE / PAGE_SIZE ) ];
+  ftl::BlockInfo  blocks[ NUM_BLOCKS ];
+  uint8_t         scratch[ PAGE_SIZE ];
+  uint8_t         write_data[ PAGE_SIZE ];
+  uint8_t         read_data[ PAGE_SIZE ];
+
+  void setup()
+  {
+    mock().ignoreOtherCalls();
+
+    /*-------------------------------------------------------------------------
+    Back the FTL with a file so state survives a reopen
+    -------------------------------------------------------------------------*/
+    DeviceConfig flash_cfg;
+    memset( &flash_cfg, 0, sizeof( flash_cfg ) );
+    flash_cfg.dev_attr.block_size = BLOCK_SIZE;
+    flash_cfg.dev_attr.size       = BLOCK_SIZE * NUM_BLOCKS;
+
+    s_flash              = new fake::memory::nor::FileFlash();
+    s_flash_writes       = 0;
+    s_flash_erases       = 0;
+    s_last_write_address = 0;
+
+    std::remove( "ftl_test.bin" );
+    s_flash->open( "ftl_test.bin", flash_cfg );
+
+    /*-------------------------------------------------------------------------
+    Describe the geometry and hand over the RAM the FTL works out of
+    -------------------------------------------------------------------------*/
+    cfg.backend.read  = ftl::ReadFunc::create<backend_read>();
+    cfg.backend.write = ftl::WriteFunc::create<backend_write>();
+    cfg.backend.erase = ftl::EraseFunc::create<backend_erase>();
+    cfg.page_size     = PAGE_SIZE;
+    cfg.block_size    = BLOCK_SIZE;
+    cfg.num_blocks    = NUM_BLOCKS;
+    cfg.spare_blocks  = 8;
+    cfg.map           = map;
+    cfg.map_entries   = sizeof( map ) / sizeof( map[ 0 ] );
+    cfg.blocks        = blocks;
+    cfg.scratch       = scratch;
+
+    test_ftl = new ftl::FTL();
+  }
+
+  void teardown()
+  {
+    test_ftl->close();
+    delete test_ftl;
+
+    s_flash->close();
+    delete s_flash;
+
+    mock().checkExpectations();
+    mock().clear();
+  }
+};
+
+
+TEST( nor_ftl, open_bad_config )
+{
+  ftl::Config bad;
+
+  /*---------------------------------------------------------------------------
+  Test Case: No backend
+  ---------------------------------------------------------------------------*/
+  bad              = cfg;
+  bad.backend.read = ftl::ReadFunc();
+  CHECK( test_ftl->open( bad ) == Status::ERR_BAD_CFG );
+
+  /*---------------------------------------------------------------------------
+  Test Case: Missing working memory
+  ---------------------------------------------------------------------------*/
+  bad     = cfg;
+  bad.map = nullptr;
+  CHECK( test_ftl->open( bad ) == Status::ERR_BAD_CFG );
+
+  bad         = cfg;
+  bad.scratch = nullptr;
+  CHECK( test_ftl->open( bad ) == Status::ERR_BAD_CFG );
+
+  /*---------------------------------------------------------------------------
+  Test Case: Pages that don't tile a block
+  ---------------------------------------------------------------------------*/
+  bad           = cfg;
+  bad.page_size = 300;
+  CHECK( test_ftl->open( bad ) == Status::ERR_BAD_CFG );
+
+  /*---------------------------------------------------------------------------
+  Test Case: Not enough spare blocks to reclaim into
+  ---------------------------------------------------------------------------*/
+  bad              = cfg;
+  bad.spare_blocks = 1;
+  CHECK( test_ftl->open( bad ) == Status::ERR_BAD_CFG );
+
+  /*---------------------------------------------------------------------------
+  Test Case: Not open
+  ---------------------------------------------------------------------------*/
+  CHECK( test_ftl->write( 0, write_data, sizeof( write_data ) ) == Status::ERR_BAD_STATE );
+  CHECK( test_ftl->read( 0, read_data, sizeof( read_data ) ) == Status::ERR_BAD_STATE );
+}
+
+
+TEST( nor_ftl, capacity_excludes_spares_and_metadata )
+{
+  CHECK( test_ftl->open( cfg ) == Status::ERR_OK );
+
+  CHECK( test_ftl->capacity() > 0 );
+  CHECK( test_ftl->capacity() <= ( NUM_BLOCKS - cfg.spare_blocks ) * BLOCK_SIZE );
+  CHECK( ( test_ftl->capacity() % PAGE_SIZE ) == 0 );
+}
+
+
+TEST( nor_ftl, bad_arguments )
+{
+  CHECK( test_ftl->open( cfg ) == Status::ERR_OK );
+
+  CHECK( test_ftl->write( 0, nullptr, 4 ) == Status::ERR_BAD_ARG );
+  CHECK( test_ftl->write( 0, write_data, 0 ) == Status::ERR_BAD_ARG );
+  CHECK( test_ftl->write( test_ftl->capacity() - 2, write_data, 4 ) == Status::ERR_BAD_ARG );
+  CHECK( test_ftl->read( 0, nullptr, 4 ) == Status::ERR_BAD_ARG );
+  CHECK( test_ftl->read( test_ftl->capacity(), read_data, 1 ) == Status::ERR_BAD_ARG );
+}
+
+
+TEST( nor_ftl, unwritten_pages_read_erased )
+{
+  CHECK( test_ftl->open( cfg ) == Status::ERR_OK );
+
+  memset( write_data, 0xFF, sizeof( write_data ) );
+  CHECK( test_ftl->read( 5 * PAGE_SIZE, read_data, sizeof( read_data ) ) == Status::ERR_OK );
+  MEMCMP_EQUAL( write_data, read_data, sizeof( read_data ) );
+}
+
+
+TEST( nor_ftl, write_then_read_back )
+{
+  CHECK( test_ftl->open( cfg ) == Status::ERR_OK );
+
+  for( size_t lpage = 0; lpage < 20; lpage++ )
+  {
+    fill_pattern( write_data, sizeof( write_data ), lpage, 0 );
+    CHECK( test_ftl->write( lpage * PAGE_SIZE, write_data, sizeof( write_data ) ) == Status::ERR_OK );
+  }
+
+  for( size_t lpage = 0; lpage < 20; lpage++ )
+  {
+    fill_pattern( write_data, sizeof( write_data ), lpage, 0 );
+    CHECK( test_ftl->read( lpage * PAGE_SIZE, read_data, sizeof( read_data ) ) == Status::ERR_OK );
+    MEMCMP_EQUAL( write_data, read_data, sizeof( read_data ) );
+  }
+}
+
+
+TEST( nor_ftl, overwrite_goes_out_of_place )
+{
+  CHECK( test_ftl->open( cfg ) == Status::ERR_OK );
+
+  fill_pattern( write_data, sizeof( write_data ), 3, 0 );
+  CHECK( test_ftl->write( 3 * PAGE_SIZE, write_data, sizeof( write_data ) ) == Status::ERR_OK );
+  const uint64_t first_location = s_last_write_address;
+
+  /*---------------------------------------------------------------------------
+  Test Case: Rewriting needs no erase and lands somewhere new
+  ---------------------------------------------------------------------------*/
+  const size_t erases_before = s_flash_erases;
+
+  fill_pattern( write_data, sizeof( write_data ), 3, 1 );
+  CHECK( test_ftl->write( 3 * PAGE_SIZE, write_data, sizeof( write_data ) ) == Status::ERR_OK );
+
+  CHECK( s_last_write_address != first_location );
+  CHECK_EQUAL( erases_before, s_flash_erases );
+
+  CHECK( test_ftl->read( 3 * PAGE_SIZE, read_data, sizeof( read_data ) ) == Status::ERR_OK );
+  MEMCMP_EQUAL( write_data, read_data, sizeof( read_data ) );
+}
+
+
+TEST( nor_ftl, partial_page_write_keeps_the_rest )
+{
+  CHECK( test_ftl->open( cfg ) == Status::ERR_OK );
+
+  fill_pattern( write_data, sizeof( write_data ), 7, 0 );
+  CHECK( test_ftl->write( 7 * PAGE_SIZE, write_data, sizeof( write_data ) ) == Status::ERR_OK );
+
+  /*---------------------------------------------------------------------------
+  Test Case: A few bytes in the middle, then a write straddling two pages
+  ---------------------------------------------------------------------------*/
+  const uint8_t patch[ 8 ] = { 0xDE, 0xAD, 0xBE, 0xEF, 0xCA, 0xFE, 0xF0, 0x0D };
+
+  CHECK( test_ftl->write( 7 * PAGE_SIZE + 100, patch, sizeof( patch ) ) == Status::ERR_OK );
+  memcpy( &write_data[ 100 ], patch, sizeof( patch ) );
+
+  CHECK( test_ftl->read( 7 * PAGE_SIZE, read_data, sizeof( read_data ) ) == Status::ERR_OK );
+  MEMCMP_EQUAL( write_data, read_data, sizeof( read_data ) );
+
+  CHECK( test_ftl->write( 8 * PAGE_SIZE - 4, patch, sizeof( patch ) ) == Status::ERR_OK );
+
+  uint8_t straddle[ sizeof( patch ) ];
+  CHECK( test_ftl->read( 8 * PAGE_SIZE - 4, straddle, sizeof( straddle ) ) == Status::ERR_OK );
+  MEMCMP_EQUAL( patch, straddle, sizeof( patch ) );
+}
+
+
+TEST( nor_ftl, mapping_rebuilt_on_reopen )
+{
+  CHECK( test_ftl->open( cfg ) == Status::ERR_OK );
+
+  for( size_t version = 0; version < 3; version++ )
+  {
+    for( size_t lpage = 0; lpage < 10; lpage++ )
+    {
+      fill_pattern( write_data, sizeof( write_data ), lpage, version );
+      CHECK( test_ftl->write( lpage * PAGE_SIZE, write_data, sizeof( write_data ) ) == Status::ERR_OK );
+    }
+  }
+
+  /*---------------------------------------------------------------------------
+  Test Case: A fresh instance with wiped RAM finds the newest copies
+  ---------------------------------------------------------------------------*/
+  test_ftl->close();
+  memset( map, 0, sizeof( map ) );
+  memset( blocks, 0, sizeof( blocks ) );
+
+  CHECK( test_ftl->open( cfg ) == Status::ERR_OK );
+
+  for( size_t lpage = 0; lpage < 10; lpage++ )
+  {
+    fill_pattern( write_data, sizeof( write_data ), lpage, 2 );
+    CHECK( test_ftl->read( lpage * PAGE_SIZE, read_data, sizeof( read_data ) ) == Status::ERR_OK );
+    MEMCMP_EQUAL( write_data, read_data, sizeof( read_data ) );
+  }
+}
+
+
+TEST( nor_ftl, background_reclaim_frees_blocks )
+{
+  CHECK( test_ftl->open( cfg ) == Status::ERR_OK );
+
+  /*---------------------------------------------------------------------------
+  Overwrite a small working set until most of the free pool holds stale data
+  ---------------------------------------------------------------------------*/
+  const size_t pages_per_block = BLOCK_SIZE / PAGE_SIZE;
+  for( size_t i = 0; i < 4 * pages_per_block; i++ )
+  {
+    fill_pattern( write_data, sizeof( write_data ), i % 4, i );
+    CHECK( test_ftl->write( ( i % 4 ) * PAGE_SIZE, write_data, sizeof( write_data ) ) == Status::ERR_OK );
+  }
+
+  const size_t free_before = test_ftl->stats().free_blocks;
+
+  /*---------------------------------------------------------------------------
+  Test Case: Each reclaim step erases at most the requested number of blocks
+  ---------------------------------------------------------------------------*/
+  CHECK_EQUAL( 1, test_ftl->reclaim( 1 ) );
+  CHECK_EQUAL( free_before + 1, test_ftl->stats().free_blocks );
+
+  CHECK( test_ftl->reclaim( NUM_BLOCKS ) > 0 );
+  CHECK_EQUAL( 0, test_ftl->reclaim( NUM_BLOCKS ) );
+
+  /* Live data untouched by the moves */
+  for( size_t lpage = 0; lpage < 4; lpage++ )
+  {
+    const size_t last_version = ( 4 * pages_per_block ) - 4 + lpage;
+    fill_pattern( write_data, sizeof( write_data ), lpage, last_version );
+    CHECK( test_ftl->read( lpage * PAGE_SIZE, read_data, sizeof( read_data ) ) == Status::ERR_OK );
+    MEMCMP_EQUAL( write_data, read_data, sizeof( read_data ) );
+  }
+}
+
+
+TEST( nor_ftl, wear_distribution_under_hot_spot )
+{
+  CHECK( test_ftl->open( cfg ) == Status::ERR_OK );
+
+  /*---------------------------------------------------------------------------
+  Half the device holds cold data written once
+  ---------------------------------------------------------------------------*/
+  const size_t num_lpages = test_ftl->capacity() / PAGE_SIZE;
+  const size_t cold_pages = num_lpages / 2;
+
+  for( size_t lpage = 0; lpage < cold_pages; lpage++ )
+  {
+    fill_pattern( write_data, sizeof( write_data ), lpage, 0 );
+    CHECK( test_ftl->write( lpage * PAGE_SIZE, write_data, sizeof( write_data ) ) == Status::ERR_OK );
+  }
+
+  uint32_t baseline[ NUM_BLOCKS ];
+  for( size_t block = 0; block < NUM_BLOCKS; block++ )
+  {
+    baseline[ block ] = test_ftl->eraseCount( block );
+  }
+
+  /*---------------------------------------------------------------------------
+  Hammer four logical pages, the recorder/staging pattern that would wear a
+  single sector out if written in place.
+  ---------------------------------------------------------------------------*/
+  constexpr size_t HOT_WRITES = 20000;
+  for( size_t i = 0; i < HOT_WRITES; i++ )
+  {
+    const size_t lpage = cold_pages + ( i % 4 );
+    fill_pattern( write_data, sizeof( write_data ), lpage, i );
+    CHECK( test_ftl->write( lpage * PAGE_SIZE, write_data, sizeof( write_data ) ) == Status::ERR_OK );
+  }
+
+  /*---------------------------------------------------------------------------
+  Test Case: Erases are spread evenly over every block that rotated
+  ---------------------------------------------------------------------------*/
+  uint32_t min_erases = UINT32_MAX;
+  uint32_t max_erases = 0;
+  size_t   rotating   = 0;
+
+  for( size_t block = 0; block < NUM_BLOCKS; block++ )
+  {
+    const uint32_t count = test_ftl->eraseCount( block ) - baseline[ block ];
+    if( count == 0 )
+    {
+      continue;
+    }
+
+    rotating++;
+    min_erases = std::min( min_erases, count );
+    max_erases = std::max( max_erases, count );
+  }
+
+  /* Every block outside the cold region takes part in the rotation */
+  CHECK( rotating >= NUM_BLOCKS - ( cold_pages / ( BLOCK_SIZE / PAGE_SIZE ) ) - 1 );
+
+  /* Dynamic wear leveling keeps the rotating pool within a few cycles */
+  CHECK( max_erases <= min_erases + 4 );
+
+  /* Far fewer erases on the worst block than an in-place rewrite would cost */
+  CHECK( max_erases * 10 < HOT_WRITES / 4 );
+
+  /* Cold data is still intact after all the reclamation */
+  for( size_t lpage = 0; lpage < cold_pages; lpage += 17 )
+  {
+    fill_pattern( write_data, sizeof( write_data ), lpage, 0 );
+    CHECK( test_ftl->read( lpage * PAGE_SIZE, read_data, sizeof( read_data ) ) == Status::ERR_OK );
+    MEMCMP_EQUAL( write_data, read_data, sizeof( read_data ) );
+  }
+}
@@ -0,0 +1,438 @@
+/******************************************************************************
+ *  File Name:
+ *    test_nor_sfdp.cpp
+ *
+ *  Description:
+ *    Test cases for nor_sfdp.cpp
+ *
+ *  2024 | Brandon Braun | brandonbraun653@protonmail.com
+ *****************************************************************************/
+
+/*-----------------------------------------------------------------------------
+Includes
+-----------------------------------------------------------------------------*/
+#include <cstring>
+#include <mbedutils/drivers/memory/nvm/nor_flash.hpp>
+#include <mbedutils/drivers/memory/nvm/nor_sfdp.hpp>
+
+#include <CppUTest/CommandLineTestRunner.h>
+#include <CppUTest/TestHarness.h>
+#include <CppUTestExt/MockSupport.h>
+#include "gpio_intf_expect.hpp"
+#include "spi_intf_expect.hpp"
+
+using namespace mb::memory;
+using namespace mb::memory::nor;
+
+/*-----------------------------------------------------------------------------
+Constants
+-----------------------------------------------------------------------------*/
+
+/**
+ * @brief SFDP header recorded from a 128 Mbit JESD216B part
+ */
+static const uint8_t s_sfdp_header[ 8 ] = {
+  0x53, 0x46, 0x44, 0x50,    // "SFDP" signature
+  0x06,                      // Minor revision
+  0x01,                      // Major revision
+  0x00,                      // Number of parameter headers - 1
+  0xFF,                      // Access protocol
+};
+
+/**
+ * @brief Parameter header pointing at the Basic Flash Parameter Table
+ */
+static const uint8_t s_sfdp_bfpt_param_header[ 8 ] = {
+  0x00,                // ID LSB, 0x00 == BFPT
+  0x06,                // Minor revision
+  0x01,                // Major revision
+  0x10,                // Length in DWORDs
+  0x30, 0x00, 0x00,    // Parameter table pointer
+  0xFF,                // ID MSB
+};
+
+/**
+ * @brief Basic Flash Parameter Table, 16 DWORDs, little endian
+ */
+static const uint8_t s_sfdp_bfpt[ 64 ] = {
+  0x05, 0x20, 0xD1, 0xFF,    // 1: 4K erase 0x20, 1-1-2, 1-2-2, 1-1-4 reads, 3-byte addressing
+  0xFF, 0xFF, 0xFF, 0x07,    // 2: Density, 128 Mbit
+  0x00, 0x00, 0x08, 0x6B,    // 3: 1-4-4 unsupported, 1-1-4 0x6B with 8 dummy clocks
+  0x08, 0x3B, 0x04, 0xBB,    // 4: 1-1-2 0x3B with 8 dummy clocks, 1-2-2 0xBB with 4 dummy clocks
+  0xEE, 0xFF, 0xFF, 0xFF,    // 5: No 2-2-2 or 4-4-4
+  0xFF, 0xFF, 0x00, 0x00,    // 6: 2-2-2 unsupported
+  0xFF, 0xFF, 0x00, 0x00,    // 7: 4-4-4 unsupported
+  0x0C, 0x20, 0x0F, 0x52,    // 8: Erase type 1 4K 0x20, type 2 32K 0x52
+  0x10, 0xD8, 0x00, 0x00,    // 9: Erase type 3 64K 0xD8, type 4 unsupported
+  0x21, 0x02, 0x06, 0x01,    // 10: Erase typ 48ms / 128ms / 256ms, max = 4x typ
+  0x82, 0x65, 0x0D, 0xC9,    // 11: 256B page, program typ 384us, chip erase typ 40s, max = 6x typ
+  0xFF, 0xFF, 0xFF, 0xFF,    // 12: Suspend/resume not supported
+  0xFF, 0xFF, 0xFF, 0xFF,    // 13
+  0xFF, 0xFF, 0xFF, 0xFF,    // 14
+  0xFF, 0xFF, 0xFF, 0xFF,    // 15
+  0xFF, 0xFF, 0xFF, 0xFF,    // 16
+};
+
+/*-----------------------------------------------------------------------------
+Tests
+-----------------------------------------------------------------------------*/
+
+int main( int argc, char **argv )
+{
+  return RUN_ALL_TESTS( argc, argv );
+}
+
+
+TEST_GROUP( nor_sfdp )
+{
+  DeviceConfig cfg;
+  sfdp::Info   info;
+  uint8_t      read_cmds[ 4 ][ 5 ];
+  size_t       num_read_cmds;
+  uint8_t      header[ 8 ];
+  uint8_t      param_header[ 8 ];
+  uint8_t      bfpt[ 64 ];
+
+  void setup()
+  {
+    memset( &cfg, 0, sizeof( cfg ) );
+    memset( &info, 0, sizeof( info ) );
+    num_read_cmds = 0;
+
+    memcpy( header, s_sfdp_header, sizeof( header ) );
+    memcpy( param_header, s_sfdp_bfpt_param_header, sizeof( param_header ) );
+    memcpy( bfpt, s_sfdp_bfpt, sizeof( bfpt ) );
+
+    mock().ignoreOtherCalls();
+  }
+
+  void teardown()
+  {
+    mock().checkExpectations();
+    mock().clear();
+  }
+
+  void expect_sfdp_read( const uint32_t address, const uint8_t *data, const size_t size )
+  {
+    /*-------------------------------------------------------------------------
+    READ SFDP: opcode, 24-bit address, one dummy byte
+    -------------------------------------------------------------------------*/
+    uint8_t *cmd = read_cmds[ num_read_cmds++ ];
+    cmd[ 0 ]     = 0x5A;
+    cmd[ 1 ]     = static_cast<uint8_t>( address >> 16 );
+    cmd[ 2 ]     = static_cast<uint8_t>( address >> 8 );
+    cmd[ 3 ]     = static_cast<uint8_t>( address );
+    cmd[ 4 ]     = 0x00;
+
+    mock()
+        .expectOneCall( "mb::hw::spi::intf::write" )
+        .withParameter( "port", cfg.spi_port )
+        .withMemoryBufferParameter( "data", cmd, 5 )
+        .withParameter( "length", static_cast<size_t>( 5 ) );
+
+    mock()
+        .expectOneCall( "mb::hw::spi::intf::read" )
+        .withParameter( "port", cfg.spi_port )
+        .withOutputParameterReturning( "data", data, size )
+        .withParameter( "length", size )
+        .ignoreOtherParameters();
+  }
+
+  void expect_full_table()
+  {
+    this->expect_sfdp_read( 0x00, header, sizeof( header ) );
+    this->expect_sfdp_read( 0x08, param_header, sizeof( param_header ) );
+    this->expect_sfdp_read( 0x30, bfpt, sizeof( bfpt ) );
+  }
+};
+
+
+TEST( nor_sfdp, read_bad_signature )
+{
+  /*---------------------------------------------------------------------------
+  Initialize
+  ---------------------------------------------------------------------------*/
+  header[ 0 ] = 0xFF;
+  this->expect_sfdp_read( 0x00, header, sizeof( header ) );
+
+  /*---------------------------------------------------------------------------
+  Call FUT
+  ---------------------------------------------------------------------------*/
+  auto result = sfdp::read( cfg, info );
+
+  /*---------------------------------------------------------------------------
+  Verify
+  ---------------------------------------------------------------------------*/
+  CHECK( result == Status::ERR_NOT_SUPPORTED );
+}
+
+
+TEST( nor_sfdp, read_without_basic_flash_parameters )
+{
+  /*---------------------------------------------------------------------------
+  Initialize
+  ---------------------------------------------------------------------------*/
+  param_header[ 0 ] = 0x84;    // Some vendor table, not the BFPT
+  this->expect_sfdp_read( 0x00, header, sizeof( header ) );
+  this->expect_sfdp_read( 0x08, param_header, sizeof( param_header ) );
+
+  /*---------------------------------------------------------------------------
+  Call FUT
+  ---------------------------------------------------------------------------*/
+  auto result = sfdp::read( cfg, info );
+
+  /*---------------------------------------------------------------------------
+  Verify
+  ---------------------------------------------------------------------------*/
+  CHECK( result == Status::ERR_NOT_SUPPORTED );
+}
+
+
+TEST( nor_sfdp, read_basic_flash_parameter_table )
+{
+  /*---------------------------------------------------------------------------
+  Initialize
+  ---------------------------------------------------------------------------*/
+  this->expect_full_table();
+
+  /*---------------------------------------------------------------------------
+  Call FUT
+  ---------------------------------------------------------------------------*/
+  auto result = sfdp::read( cfg, info );
+
+  /*---------------------------------------------------------------------------
+  Verify
+  ---------------------------------------------------------------------------*/
+  CHECK( result == Status::ERR_OK );
+  CHECK_EQUAL( 1, info.major );
+  CHECK_EQUAL( 6, info.minor );
+  CHECK_EQUAL( 16 * 1024 * 1024, info.density_bytes );
+  CHECK_EQUAL( 256, info.page_size );
+
+  /* Erase types */
+  CHECK_EQUAL( 4096, info.erase[ 0 ].size );
+  CHECK_EQUAL( 0x20, info.erase[ 0 ].opcode );
+  CHECK_EQUAL( 48, info.erase[ 0 ].typ_ms );
+  CHECK_EQUAL( 192, info.erase[ 0 ].max_ms );
+
+  CHECK_EQUAL( 32 * 1024, info.erase[ 1 ].size );
+  CHECK_EQUAL( 0x52, info.erase[ 1 ].opcode );
+  CHECK_EQUAL( 128, info.erase[ 1 ].typ_ms );
+  CHECK_EQUAL( 512, info.erase[ 1 ].max_ms );
+
+  CHECK_EQUAL( 64 * 1024, info.erase[ 2 ].size );
+  CHECK_EQUAL( 0xD8, info.erase[ 2 ].opcode );
+  CHECK_EQUAL( 256, info.erase[ 2 ].typ_ms );
+  CHECK_EQUAL( 1024, info.erase[ 2 ].max_ms );
+
+  CHECK_EQUAL( 0, info.erase[ 3 ].size );
+
+  /* Fast reads */
+  CHECK( info.read_112.supported );
+  CHECK_EQUAL( 0x3B, info.read_112.opcode );
+  CHECK_EQUAL( 8, info.read_112.dummy_clocks );
+
+  CHECK( info.read_122.supported );
+  CHECK_EQUAL( 0xBB, info.read_122.opcode );
+  CHECK_EQUAL( 4, info.read_122.dummy_clocks );
+
+  CHECK( info.read_114.supported );
+  CHECK_EQUAL( 0x6B, info.read_114.opcode );
+  CHECK_EQUAL( 8, info.read_114.dummy_clocks );
+
+  CHECK_FALSE( info.read_144.supported );
+
+  /* Program and chip erase timing */
+  CHECK_EQUAL( 384, info.page_program_typ_us );
+  CHECK_EQUAL( 2304, info.page_program_max_us );
+  CHECK_EQUAL( 40000, info.chip_erase_typ_ms );
+  CHECK_EQUAL( 240000, info.chip_erase_max_ms );
+}
+
+
+TEST( nor_sfdp, read_legacy_nine_dword_table )
+{
+  /*---------------------------------------------------------------------------
+  Initialize: original JESD216 parts stop after the erase types
+  ---------------------------------------------------------------------------*/
+  param_header[ 1 ] = 0x00;
+  param_header[ 3 ] = 0x09;
+
+  this->expect_sfdp_read( 0x00, header, sizeof( header ) );
+  this->expect_sfdp_read( 0x08, param_header, sizeof( param_header ) );
+  this->expect_sfdp_read( 0x30, bfpt, 9 * sizeof( uint32_t ) );
+
+  /*---------------------------------------------------------------------------
+  Call FUT
+  ---------------------------------------------------------------------------*/
+  auto result = sfdp::read( cfg, info );
+
+  /*---------------------------------------------------------------------------
+  Verify
+  ---------------------------------------------------------------------------*/
+  CHECK( result == Status::ERR_OK );
+  CHECK_EQUAL( 16 * 1024 * 1024, info.density_bytes );
+  CHECK_EQUAL( 0xD8, info.erase[ 2 ].opcode );
+
+  /* Anything past DWORD 9 is reported as unknown */
+  CHECK_EQUAL( 0, info.page_size );
+  CHECK_EQUAL( 0, info.erase[ 0 ].max_ms );
+  CHECK_EQUAL( 0, info.chip_erase_max_ms );
+}
+
+
+TEST( nor_sfdp, apply_fills_device_attributes )
+{
+  /*---------------------------------------------------------------------------
+  Initialize
+  ---------------------------------------------------------------------------*/
+  this->expect_full_table();
+  CHECK( sfdp::read( cfg, info ) == Status::ERR_OK );
+
+  /*---------------------------------------------------------------------------
+  Call FUT
+  ---------------------------------------------------------------------------*/
+  auto result = sfdp::apply( info, cfg );
+
+  /*---------------------------------------------------------------------------
+  Verify
+  ---------------------------------------------------------------------------*/
+  CHECK( result == Status::ERR_OK );
+  CHECK_EQUAL( 16 * 1024 * 1024, cfg.dev_attr.size );
+  CHECK_EQUAL( 256, cfg.dev_attr.write_size );
+  CHECK_EQUAL( 256, cfg.dev_attr.read_size );
+  CHECK_EQUAL( 4096, cfg.dev_attr.block_size );
+  CHECK_EQUAL( 4096, cfg.dev_attr.erase_size );
+  CHECK_EQUAL( ERASE_OP_4K | ERASE_OP_32K | ERASE_OP_64K | ERASE_OP_CHIP, cfg.dev_attr.erase_ops );
+
+  /* Latencies use the worst case so pend_event never times out early */
+  CHECK_EQUAL( 192, cfg.dev_attr.erase_latency );
+  CHECK_EQUAL( 512, cfg.dev_attr.erase_32k_latency );
+  CHECK_EQUAL( 1024, cfg.dev_attr.erase_64k_latency );
+  CHECK_EQUAL( 240000, cfg.dev_attr.erase_chip_latency );
+  CHECK_EQUAL( 3, cfg.dev_attr.write_latency );
+
+  /* A single data line bus keeps the driver's default read command */
+  CHECK_EQUAL( 0, cfg.read_mode.opcode );
+}
+
+
+TEST( nor_sfdp, apply_keeps_manual_values_the_table_omits )
+{
+  /*---------------------------------------------------------------------------
+  Initialize
+  ---------------------------------------------------------------------------*/
+  param_header[ 1 ] = 0x00;
+  param_header[ 3 ] = 0x09;
+
+  this->expect_sfdp_read( 0x00, header, sizeof( header ) );
+  this->expect_sfdp_read( 0x08, param_header, sizeof( param_header ) );
+  this->expect_sfdp_read( 0x30, bfpt, 9 * sizeof( uint32_t ) );
+  CHECK( sfdp::read( cfg, info ) == Status::ERR_OK );
+
+  cfg.dev_attr.write_size         = 256;
+  cfg.dev_attr.read_size          = 256;
+  cfg.dev_attr.erase_latency      = 300;
+  cfg.dev_attr.erase_32k_latency  = 600;
+  cfg.dev_attr.erase_64k_latency  = 1200;
+  cfg.dev_attr.erase_chip_latency = 100000;
+  cfg.dev_attr.write_latency      = 5;
+
+  /*---------------------------------------------------------------------------
+  Call FUT
+  ---------------------------------------------------------------------------*/
+  auto result = sfdp::apply( info, cfg );
+
+  /*---------------------------------------------------------------------------
+  Verify
+  ---------------------------------------------------------------------------*/
+  CHECK( result == Status::ERR_OK );
+  CHECK_EQUAL( 16 * 1024 * 1024, cfg.dev_attr.size );
+  CHECK_EQUAL( ERASE_OP_4K | ERASE_OP_32K | ERASE_OP_64K | ERASE_OP_CHIP, cfg.dev_attr.erase_ops );
+  CHECK_EQUAL( 256, cfg.dev_attr.write_size );
+  CHECK_EQUAL( 300, cfg.dev_attr.erase_latency );
+  CHECK_EQUAL( 600, cfg.dev_attr.erase_32k_latency );
+  CHECK_EQUAL( 1200, cfg.dev_attr.erase_64k_latency );
+  CHECK_EQUAL( 100000, cfg.dev_attr.erase_chip_latency );
+  CHECK_EQUAL( 5, cfg.dev_attr.write_latency );
+}
+
+
+TEST( nor_sfdp, apply_selects_quad_output_read )
+{
+  /*---------------------------------------------------------------------------
+  Initialize
+  ---------------------------------------------------------------------------*/
+  this->expect_full_table();
+  CHECK( sfdp::read( cfg, info ) == Status::ERR_OK );
+
+  cfg.spi_data_lines = 4;
+
+  /*---------------------------------------------------------------------------
+  Call FUT
+  ---------------------------------------------------------------------------*/
+  auto result = sfdp::apply( info, cfg );
+
+  /*---------------------------------------------------------------------------
+  Verify: 1-4-4 is not supported by the part, so 1-1-4 is the widest
+  ---------------------------------------------------------------------------*/
+  CHECK( result == Status::ERR_OK );
+  CHECK_EQUAL( 0x6B, cfg.read_mode.opcode );
+  CHECK_EQUAL( 8, cfg.read_mode.dummy_clocks );
+  CHECK_EQUAL( 1, cfg.read_mode.addr_lines );
+  CHECK_EQUAL( 4, cfg.read_mode.data_lines );
+}
+
+
+TEST( nor_sfdp, apply_selects_dual_io_read )
+{
+  /*---------------------------------------------------------------------------
+  Initialize
+  ---------------------------------------------------------------------------*/
+  this->expect_full_table();
+  CHECK( sfdp::read( cfg, info ) == Status::ERR_OK );
+
+  cfg.spi_data_lines = 2;
+
+  /*---------------------------------------------------------------------------
+  Call FUT
+  ---------------------------------------------------------------------------*/
+  auto result = sfdp::apply( info, cfg );
+
+  /*---------------------------------------------------------------------------
+  Verify: 1-2-2 also moves the address over both lines
+  ---------------------------------------------------------------------------*/
+  CHECK( result == Status::ERR_OK );
+  CHECK_EQUAL( 0xBB, cfg.read_mode.opcode );
+  CHECK_EQUAL( 4, cfg.read_mode.dummy_clocks );
+  CHECK_EQUAL( 2, cfg.read_mode.addr_lines );
+  CHECK_EQUAL( 2, cfg.read_mode.data_lines );
+}
+
+
+TEST( nor_sfdp, apply_falls_back_to_dual_output_read )
+{
+  /*---------------------------------------------------------------------------
+  Initialize
+  ---------------------------------------------------------------------------*/
+  bfpt[ 2 ] &= ~0x10;    // Clear the 1-2-2 support bit in DWORD 1
+  this->expect_full_table();
+  CHECK( sfdp::read( cfg, info ) == Status::ERR_OK );
+  CHECK_FALSE( info.read_122.supported );
+
+  cfg.spi_data_lines = 2;
+
+  /*---------------------------------------------------------------------------
+  Call FUT
+  ---------------------------------------------------------------------------*/
+  auto result = sfdp::apply( info, cfg );
+
+  /*---------------------------------------------------------------------------
+  Verify
+  ---------------------------------------------------------------------------*/
+  CHECK( result == Status::ERR_OK );
+  CHECK_EQUAL( 0x3B, cfg.read_mode.opcode );
+  CHECK_EQUAL( 8, cfg.read_mode.dummy_clocks );
+  CHECK_EQUAL( 1, cfg.read_mode.addr_lines );
+  CHECK_EQUAL( 2, cfg.read_mode.data_lines );
+}
@@ -0,0 +1,518 @@
+/******************************************************************************
+ *  File Name:
+ *    test_nor_striped.cpp
+ *
+ *  Description:
+ *    Test cases for nor_striped.cpp
+ *
+ *  2024 | Brandon Braun | brandonbraun653@protonmail.com
+ *****************************************************************************/
+
+/*-----------------------------------------------------------------------------
+Includes
+-----------------------------------------------------------------------------*/
+#include <cstdint>
+#include <cstring>
+#include <mbedutils/drivers/memory/nvm/jedec_cfi_cmds.hpp>
+#include <mbedutils/drivers/memory/nvm/nor_flash.hpp>
+#include <mbedutils/drivers/memory/nvm/nor_flash_device.hpp>
+#include <mbedutils/drivers/memory/nvm/nor_striped.hpp>
+
+#include <CppUTest/TestHarness.h>
+#include <CppUTest/CommandLineTestRunner.h>
+#include "assert_expect.hpp"
+#include "gpio_intf_expect.hpp"
+#include "spi_intf_expect.hpp"
+#include "mutex_intf_expect.hpp"
+#include "nor_flash_device_expect.hpp"
+#include "time_intf_expect.hpp"
+
+using namespace mb::hw;
+using namespace mb::memory;
+using namespace mb::memory::nor;
+using namespace CppUMockGen;
+
+/*-----------------------------------------------------------------------------
+Constants
+-----------------------------------------------------------------------------*/
+
+static constexpr size_t BLOCK_SIZE = 4096;
+static constexpr size_t CHIP_SIZE  = 0x800000;
+
+/*-----------------------------------------------------------------------------
+Static Data
+-----------------------------------------------------------------------------*/
+
+static size_t s_async_calls;
+static Event  s_async_event;
+static Status s_async_status;
+
+/*-----------------------------------------------------------------------------
+Static Functions
+-----------------------------------------------------------------------------*/
+
+/**
+ * @brief Records the result of an asynchronous striped operation
+ */
+static void cb_async_complete( const Event event, const Status status )
+{
+  s_async_calls++;
+  s_async_event  = event;
+  s_async_status = status;
+}
+
+/*-----------------------------------------------------------------------------
+Tests
+-----------------------------------------------------------------------------*/
+
+int main( int argc, char **argv )
+{
+  return RUN_ALL_TESTS( argc, argv );
+}
+
+TEST_GROUP( nor_striped )
+{
+  DeviceDriver  chip_0;
+  DeviceDriver  chip_1;
+  DeviceConfig  cfg_0;
+  DeviceConfig  cfg_1;
+  StripeConfig  stripe_cfg;
+  StripedDevice striped;
+  uint8_t       buffer[ 32 ];
+  uint8_t       cmds[ 8 ][ cfi::READ_ARRAY_HS_OPS_LEN ];
+  size_t        num_cmds;
+
+  void setup()
+  {
+    mock().ignoreOtherCalls();
+
+    /*-------------------------------------------------------------------------
+    Two identical parts on separate SPI buses
+    -------------------------------------------------------------------------*/
+    memset( &cfg_0, 0, sizeof( cfg_0 ) );
+
+    cfg_0.dev_attr.block_size         = BLOCK_SIZE;
+    cfg_0.dev_attr.read_size          = 256;
+    cfg_0.dev_attr.write_size         = 256;
+    cfg_0.dev_attr.erase_size         = BLOCK_SIZE;
+    cfg_0.dev_attr.size               = CHIP_SIZE;
+    cfg_0.dev_attr.erase_latency      = 100;
+    cfg_0.dev_attr.erase_chip_latency = 10000;
+    cfg_0.dev_attr.write_latency      = 5;
+    cfg_0.pend_event_cb               = device::adesto_at25sfxxx_pend_event;
+    cfg_0.poll_event_cb               = device::adesto_at25sfxxx_poll_event;
+
+    cfg_1            = cfg_0;
+    cfg_1.spi_port   = 1;
+    cfg_1.spi_cs_pin = 1;
+
+    chip_0.open( cfg_0 );
+    chip_1.open( cfg_1 );
+
+    /*-------------------------------------------------------------------------
+    Reset the test data
+    -------------------------------------------------------------------------*/
+    memset( &stripe_cfg, 0, sizeof( stripe_cfg ) );
+    stripe_cfg.devices[ 0 ] = &chip_0;
+    stripe_cfg.devices[ 1 ] = &chip_1;
+    stripe_cfg.num_devices  = 2;
+
+    for( size_t i = 0; i < sizeof( buffer ); i++ )
+    {
+      buffer[ i ] = static_cast<uint8_t>( i );
+    }
+
+    num_cmds       = 0;
+    s_async_calls  = 0;
+    s_async_event  = Event::MEM_ERROR;
+    s_async_status = Status::ERR_OK;
+  }
+
+  void teardown()
+  {
+    striped.close();
+    chip_0.close();
+    chip_1.close();
+    mock().checkExpectations();
+    mock().clear();
+  }
+
+  void expect_write_enable( const DeviceConfig &cfg )
+  {
+    expect::mb$::hw$::gpio$::intf$::write( 1, cfg.spi_cs_port, cfg.spi_cs_pin, gpio::State_t::STATE_LOW );
+    expect::mb$::hw$::spi$::intf$::write( 1, cfg.spi_port, IgnoreParameter(),
+                                          static_cast<size_t>( cfi::WRITE_ENABLE_OPS_LEN ) );
+    expect::mb$::hw$::gpio$::intf$::write( 1, cfg.spi_cs_port, cfg.spi_cs_pin, gpio::State_t::STATE_HIGH );
+  }
+
+  void expect_cmd( const DeviceConfig &cfg, const uint8_t opcode, const uint32_t address, const size_t length )
+  {
+    /*-------------------------------------------------------------------------
+    Opcode, 24-bit big endian chip address, then zeroed dummy bytes if any
+    -------------------------------------------------------------------------*/
+    CHECK( num_cmds < 8 );
+    CHECK( length <= sizeof( cmds[ 0 ] ) );
+
+    uint8_t *cmd = cmds[ num_cmds++ ];
+    memset( cmd, 0, sizeof( cmds[ 0 ] ) );
+    cmd[ 0 ] = opcode;
+    cmd[ 1 ] = static_cast<uint8_t>( address >> 16 );
+    cmd[ 2 ] = static_cast<uint8_t>( address >> 8 );
+    cmd[ 3 ] = static_cast<uint8_t>( address );
+
+    mock()
+        .expectOneCall( "mb::hw::spi::intf::write" )
+        .withParameter( "port", cfg.spi_port )
+        .withMemoryBufferParameter( "data", cmd, length )
+        .withParameter( "length", length );
+  }
+
+  void expect_async_program( const DeviceConfig &cfg, const uint32_t address, const void *data, const size_t size,
+                             const size_t start_ms )
+  {
+    /*-------------------------------------------------------------------------
+    Program command is issued on the chip's bus, then released
+    -------------------------------------------------------------------------*/
+    expect::mb$::hw$::spi$::intf$::lock( cfg.spi_port );
+    this->expect_write_enable( cfg );
+    expect::mb$::hw$::gpio$::intf$::write( 1, cfg.spi_cs_port, cfg.spi_cs_pin, gpio::State_t::STATE_LOW );
+    this->expect_cmd( cfg, cfi::PAGE_PROGRAM, address, cfi::PAGE_PROGRAM_OPS_LEN );
+    expect::mb$::hw$::spi$::intf$::write( 1, cfg.spi_port, data, size );
+    expect::mb$::hw$::gpio$::intf$::write( 1, cfg.spi_cs_port, cfg.spi_cs_pin, gpio::State_t::STATE_HIGH );
+    expect::mb$::hw$::spi$::intf$::unlock( cfg.spi_port );
+    expect::mb$::time$::millis( start_ms );
+  }
+
+  void expect_async_erase( const DeviceConfig &cfg, const uint32_t address, const size_t start_ms )
+  {
+    /*-------------------------------------------------------------------------
+    Block erase command is issued on the chip's bus, then released
+    -------------------------------------------------------------------------*/
+    expect::mb$::hw$::spi$::intf$::lock( cfg.spi_port );
+    this->expect_write_enable( cfg );
+    expect::mb$::hw$::gpio$::intf$::write( 1, cfg.spi_cs_port, cfg.spi_cs_pin, gpio::State_t::STATE_LOW );
+    this->expect_cmd( cfg, cfi::BLOCK_ERASE_4K, address, cfi::BLOCK_ERASE_OPS_LEN );
+    expect::mb$::hw$::gpio$::intf$::write( 1, cfg.spi_cs_port, cfg.spi_cs_pin, gpio::State_t::STATE_HIGH );
+    expect::mb$::hw$::spi$::intf$::unlock( cfg.spi_port );
+    expect::mb$::time$::millis( start_ms );
+  }
+
+  void expect_read( const DeviceConfig &cfg, const uint32_t address, void *data, const size_t size )
+  {
+    expect::mb$::hw$::spi$::intf$::lock( cfg.spi_port );
+    expect::mb$::hw$::gpio$::intf$::write( 1, cfg.spi_cs_port, cfg.spi_cs_pin, gpio::State_t::STATE_LOW );
+    this->expect_cmd( cfg, cfi::READ_ARRAY_HS, address, cfi::READ_ARRAY_HS_OPS_LEN );
+    expect::mb$::hw$::spi$::intf$::read( 1, cfg.spi_port, data, size );
+    expect::mb$::hw$::gpio$::intf$::write( 1, cfg.spi_cs_port, cfg.spi_cs_pin, gpio::State_t::STATE_HIGH );
+    expect::mb$::hw$::spi$::intf$::unlock( cfg.spi_port );
+  }
+};
+
+TEST( nor_striped, open_validates_devices )
+{
+  /*---------------------------------------------------------------------------
+  Test Case: No devices
+  ---------------------------------------------------------------------------*/
+  StripeConfig bad_cfg = stripe_cfg;
+  bad_cfg.num_devices  = 0;
+  CHECK_EQUAL( Status::ERR_BAD_ARG, striped.open( bad_cfg ) );
+
+  /*---------------------------------------------------------------------------
+  Test Case: Too many devices
+  ---------------------------------------------------------------------------*/
+  bad_cfg.num_devices = MAX_STRIPE_DEVICES + 1;
+  CHECK_EQUAL( Status::ERR_BAD_ARG, striped.open( bad_cfg ) );
+
+  /*---------------------------------------------------------------------------
+  Test Case: Missing device
+  ---------------------------------------------------------------------------*/
+  bad_cfg              = stripe_cfg;
+  bad_cfg.devices[ 1 ] = nullptr;
+  CHECK_EQUAL( Status::ERR_BAD_ARG, striped.open( bad_cfg ) );
+
+  /*---------------------------------------------------------------------------
+  Test Case: Erase granularity must match across the stripe
+  ---------------------------------------------------------------------------*/
+  DeviceDriver mismatched;
+  DeviceConfig mismatched_cfg        = cfg_1;
+  mismatched_cfg.dev_attr.erase_size = 2 * BLOCK_SIZE;
+  mismatched.open( mismatched_cfg );
+
+  bad_cfg.devices[ 1 ] = &mismatched;
+  CHECK_EQUAL( Status::ERR_BAD_ARG, striped.open( bad_cfg ) );
+  mismatched.close();
+
+  /*---------------------------------------------------------------------------
+  Test Case: Nominal
+  ---------------------------------------------------------------------------*/
+  CHECK_EQUAL( Status::ERR_OK, striped.open( stripe_cfg ) );
+  CHECK_EQUAL( 2 * CHIP_SIZE, striped.size() );
+  CHECK_EQUAL( BLOCK_SIZE, striped.stripeSize() );
+}
+
+TEST( nor_striped, capacity_limited_by_smallest_device )
+{
+  /*---------------------------------------------------------------------------
+  Initialize
+  ---------------------------------------------------------------------------*/
+  DeviceConfig big_cfg  = cfg_1;
+  big_cfg.dev_attr.size = 2 * CHIP_SIZE;
+
+  chip_1.close();
+  chip_1.open( big_cfg );
+
+  /*---------------------------------------------------------------------------
+  Test
+  ---------------------------------------------------------------------------*/
+  CHECK_EQUAL( Status::ERR_OK, striped.open( stripe_cfg ) );
+  CHECK_EQUAL( 2 * CHIP_SIZE, striped.size() );
+}
+
+TEST( nor_striped, blocks_interleave_across_devices )
+{
+  StripeLocation loc;
+
+  CHECK_EQUAL( Status::ERR_OK, striped.open( stripe_cfg ) );
+
+  /*---------------------------------------------------------------------------
+  Test Case: Block 0 lives at the start of the first chip
+  ---------------------------------------------------------------------------*/
+  CHECK_EQUAL( Status::ERR_OK, striped.locate( 0x0010, loc ) );
+  CHECK_EQUAL( 0, loc.device );
+  CHECK_EQUAL( 0x0010, loc.address );
+
+  /*---------------------------------------------------------------------------
+  Test Case: Block 1 lives at the start of the second chip
+  ---------------------------------------------------------------------------*/
+  CHECK_EQUAL( Status::ERR_OK, striped.locate( 0x1010, loc ) );
+  CHECK_EQUAL( 1, loc.device );
+  CHECK_EQUAL( 0x0010, loc.address );
+
+  /*---------------------------------------------------------------------------
+  Test Case: Block 5 wraps to the third block of the second chip
+  ---------------------------------------------------------------------------*/
+  CHECK_EQUAL( Status::ERR_OK, striped.locate( 0x5ABC, loc ) );
+  CHECK_EQUAL( 1, loc.device );
+  CHECK_EQUAL( 0x2ABC, loc.address );
+
+  /*---------------------------------------------------------------------------
+  Test Case: The last byte lives at the end of the second chip
+  ---------------------------------------------------------------------------*/
+  CHECK_EQUAL( Status::ERR_OK, striped.locate( striped.size() - 1, loc ) );
+  CHECK_EQUAL( 1, loc.device );
+  CHECK_EQUAL( CHIP_SIZE - 1, loc.address );
+
+  /*---------------------------------------------------------------------------
+  Test Case: Out of range
+  ---------------------------------------------------------------------------*/
+  CHECK_EQUAL( Status::ERR_BAD_ARG, striped.locate( striped.size(), loc ) );
+}
+
+TEST( nor_striped, operations_rejected_when_closed )
+{
+  mock().expectNoCall( "mb::hw::spi::intf::lock" );
+
+  auto cb = CompletionCallback::create<cb_async_complete>();
+
+  CHECK_EQUAL( Status::ERR_BAD_STATE, striped.read( 0, buffer, sizeof( buffer ) ) );
+  CHECK_EQUAL( Status::ERR_BAD_STATE, striped.write( 0, buffer, sizeof( buffer ) ) );
+  CHECK_EQUAL( Status::ERR_BAD_STATE, striped.erase( 0, BLOCK_SIZE ) );
+  CHECK_EQUAL( Status::ERR_BAD_STATE, striped.writeAsync( 0, buffer, sizeof( buffer ), cb ) );
+  CHECK_EQUAL( Status::ERR_BAD_STATE, striped.eraseAsync( 0, BLOCK_SIZE, cb ) );
+}
+
+TEST( nor_striped, erase_must_be_block_aligned )
+{
+  auto cb = CompletionCallback::create<cb_async_complete>();
+
+  CHECK_EQUAL( Status::ERR_OK, striped.open( stripe_cfg ) );
+  mock().expectNoCall( "mb::hw::spi::intf::lock" );
+
+  CHECK_EQUAL( Status::ERR_BAD_ARG, striped.erase( 0x0010, BLOCK_SIZE ) );
+  CHECK_EQUAL( Status::ERR_BAD_ARG, striped.eraseAsync( 0, BLOCK_SIZE + 1, cb ) );
+  CHECK_EQUAL( Status::ERR_BAD_ARG, striped.eraseAsync( 0, 0, cb ) );
+  CHECK_EQUAL( Status::ERR_BAD_ARG, striped.eraseAsync( striped.size(), BLOCK_SIZE, cb ) );
+}
+
+TEST( nor_striped, read_splits_on_stripe_boundary )
+{
+  /*---------------------------------------------------------------------------
+  Initialize
+  ---------------------------------------------------------------------------*/
+  CHECK_EQUAL( Status::ERR_OK, striped.open( stripe_cfg ) );
+
+  /*---------------------------------------------------------------------------
+  The tail of block 1 lives on chip 1, the head of block 2 on chip 0
+  ---------------------------------------------------------------------------*/
+  this->expect_read( cfg_1, 0x0FF0, &buffer[ 0 ], 16 );
+  this->expect_read( cfg_0, 0x1000, &buffer[ 16 ], 16 );
+
+  /*---------------------------------------------------------------------------
+  Test
+  ---------------------------------------------------------------------------*/
+  CHECK_EQUAL( Status::ERR_OK, striped.read( 0x1FF0, buffer, sizeof( buffer ) ) );
+}
+
+TEST( nor_striped, write_async_programs_both_devices_concurrently )
+{
+  /*---------------------------------------------------------------------------
+  Initialize
+  ---------------------------------------------------------------------------*/
+  auto cb = CompletionCallback::create<cb_async_complete>();
+  CHECK_EQUAL( Status::ERR_OK, striped.open( stripe_cfg ) );
+
+  this->expect_async_program( cfg_0, 0x0FFC, &buffer[ 0 ], 4, 100 );
+  this->expect_async_program( cfg_1, 0x0000, &buffer[ 4 ], 4, 100 );
+
+  /*---------------------------------------------------------------------------
+  Test Case: Both programs are in flight before either is waited on
+  ---------------------------------------------------------------------------*/
+  mock().expectNoCall( "mb::memory::nor::device::adesto_at25sfxxx_pend_event" );
+
+  CHECK_EQUAL( Status::ERR_OK, striped.writeAsync( 0x0FFC, buffer, 8, cb ) );
+  CHECK( striped.isBusy() );
+  CHECK( chip_0.isBusy() );
+  CHECK( chip_1.isBusy() );
+  CHECK_EQUAL( 0, s_async_calls );
+
+  /*---------------------------------------------------------------------------
+  Test Case: Completion is reported once, after both chips finish
+  ---------------------------------------------------------------------------*/
+  expect::mb$::memory$::nor$::device$::adesto_at25sfxxx_poll_event( 2, IgnoreParameter(), Event::MEM_WRITE_COMPLETE, Status::ERR_OK );
+
+  striped.process();
+  CHECK_FALSE( striped.isBusy() );
+  CHECK_EQUAL( 1, s_async_calls );
+  CHECK( s_async_event == Event::MEM_WRITE_COMPLETE );
+  CHECK_EQUAL( Status::ERR_OK, s_async_status );
+}
+
+TEST( nor_striped, erase_async_hides_latency_across_devices )
+{
+  /*---------------------------------------------------------------------------
+  Initialize
+  ---------------------------------------------------------------------------*/
+  auto cb = CompletionCallback::create<cb_async_complete>();
+  CHECK_EQUAL( Status::ERR_OK, striped.open( stripe_cfg ) );
+
+  this->expect_async_erase( cfg_0, 0x0000, 1000 );
+  this->expect_async_erase( cfg_1, 0x0000, 1000 );
+
+  /*---------------------------------------------------------------------------
+  Test Case: Blocks 0 and 1 erase in parallel
+  ---------------------------------------------------------------------------*/
+  CHECK_EQUAL( Status::ERR_OK, striped.eraseAsync( 0, 2 * BLOCK_SIZE, cb ) );
+  CHECK( chip_0.isBusy() );
+  CHECK( chip_1.isBusy() );
+
+  /*---------------------------------------------------------------------------
+  Test Case: Both chips still erasing
+  ---------------------------------------------------------------------------*/
+  expect::mb$::memory$::nor$::device$::adesto_at25sfxxx_poll_event( 2, IgnoreParameter(), Event::MEM_ERASE_COMPLETE, Status::ERR_BUSY );
+  expect::mb$::time$::millis( 2, 1050 );
+
+  striped.process();
+  CHECK( striped.isBusy() );
+  CHECK_EQUAL( 0, s_async_calls );
+
+  /*---------------------------------------------------------------------------
+  Test Case: Both done within a single erase latency
+  ---------------------------------------------------------------------------*/
+  expect::mb$::memory$::nor$::device$::adesto_at25sfxxx_poll_event( 2, IgnoreParameter(), Event::MEM_ERASE_COMPLETE, Status::ERR_OK );
+
+  striped.process();
+  CHECK_FALSE( striped.isBusy() );
+  CHECK_EQUAL( 1, s_async_calls );
+  CHECK( s_async_event == Event::MEM_ERASE_COMPLETE );
+  CHECK_EQUAL( Status::ERR_OK, s_async_status );
+}
+
+TEST( nor_striped, erase_async_queues_blocks_per_device )
+{
+  /*---------------------------------------------------------------------------
+  Initialize
+  ---------------------------------------------------------------------------*/
+  auto cb = CompletionCallback::create<cb_async_complete>();
+  CHECK_EQUAL( Status::ERR_OK, striped.open( stripe_cfg ) );
+
+  /*---------------------------------------------------------------------------
+  Test Case: Blocks 0 and 1 start, block 2 waits for chip 0
+  ---------------------------------------------------------------------------*/
+  this->expect_async_erase( cfg_0, 0x0000, 1000 );
+  this->expect_async_erase( cfg_1, 0x0000, 1000 );
+
+  CHECK_EQUAL( Status::ERR_OK, striped.eraseAsync( 0, 3 * BLOCK_SIZE, cb ) );
+
+  /*---------------------------------------------------------------------------
+  Test Case: First pass finishes, chip 0 picks up block 2
+  ---------------------------------------------------------------------------*/
+  expect::mb$::memory$::nor$::device$::adesto_at25sfxxx_poll_event( 2, IgnoreParameter(), Event::MEM_ERASE_COMPLETE, Status::ERR_OK );
+  this->expect_async_erase( cfg_0, BLOCK_SIZE, 1100 );
+
+  striped.process();
+  CHECK( striped.isBusy() );
+  CHECK( chip_0.isBusy() );
+  CHECK_FALSE( chip_1.isBusy() );
+  CHECK_EQUAL( 0, s_async_calls );
+
+  /*---------------------------------------------------------------------------
+  Test Case: Last block done
+  ---------------------------------------------------------------------------*/
+  expect::mb$::memory$::nor$::device$::adesto_at25sfxxx_poll_event( 1, IgnoreParameter(), Event::MEM_ERASE_COMPLETE, Status::ERR_OK );
+
+  striped.process();
+  CHECK_FALSE( striped.isBusy() );
+  CHECK_EQUAL( 1, s_async_calls );
+  CHECK_EQUAL( Status::ERR_OK, s_async_status );
+}
+
+TEST( nor_striped, device_failure_is_reported )
+{
+  /*---------------------------------------------------------------------------
+  Initialize
+  ---------------------------------------------------------------------------*/
+  auto cb = CompletionCallback::create<cb_async_complete>();
+  CHECK_EQUAL( Status::ERR_OK, striped.open( stripe_cfg ) );
+
+  this->expect_async_erase( cfg_0, 0x0000, 1000 );
+  this->expect_async_erase( cfg_1, 0x0000, 1000 );
+
+  CHECK_EQUAL( Status::ERR_OK, striped.eraseAsync( 0, 2 * BLOCK_SIZE, cb ) );
+
+  /*---------------------------------------------------------------------------
+  Test Case: Chip 0 finishes, chip 1 hangs past its erase latency. Devices
+  are polled in stripe order, so the expectations line up with the chips.
+  ---------------------------------------------------------------------------*/
+  expect::mb$::memory$::nor$::device$::adesto_at25sfxxx_poll_event( 1, IgnoreParameter(), Event::MEM_ERASE_COMPLETE, Status::ERR_OK );
+  expect::mb$::memory$::nor$::device$::adesto_at25sfxxx_poll_event( 1, IgnoreParameter(), Event::MEM_ERASE_COMPLETE, Status::ERR_BUSY );
+  expect::mb$::time$::millis( 1000 + cfg_1.dev_attr.erase_latency + 1 );
+
+  striped.process();
+  CHECK_FALSE( striped.isBusy() );
+  CHECK_EQUAL( 1, s_async_calls );
+  CHECK( s_async_event == Event::MEM_ERASE_COMPLETE );
+  CHECK_EQUAL( Status::ERR_TIMEOUT, s_async_status );
+}
+
+TEST( nor_striped, blocking_erase_waits_for_all_devices )
+{
+  /*---------------------------------------------------------------------------
+  Initialize
+  ---------------------------------------------------------------------------*/
+  CHECK_EQUAL( Status::ERR_OK, striped.open( stripe_cfg ) );
+
+  /*---------------------------------------------------------------------------
+  Blocks 2 and 3 both map to the second physical block of each chip
+  ---------------------------------------------------------------------------*/
+  this->expect_async_erase( cfg_0, BLOCK_SIZE, 1000 );
+  this->expect_async_erase( cfg_1, BLOCK_SIZE, 1000 );
+  expect::mb$::memory$::nor$::device$::adesto_at25sfxxx_poll_event( 2, IgnoreParameter(), Event::MEM_ERASE_COMPLETE, Status::ERR_OK );
+
+  /*---------------------------------------------------------------------------
+  Test
+  ---------------------------------------------------------------------------*/
+  CHECK_EQUAL( Status::ERR_OK, striped.erase( 2 * BLOCK_SIZE, 2 * BLOCK_SIZE ) );
+  CHECK_FALSE( striped.isBusy() );
+  CHECK_FALSE( chip_0.isBusy() );
+  CHECK_FALSE( chip_1.isBusy() );
+}